@@ -6,7 +6,7 @@ namespace Util {
 
 namespace Files {
 
-    char* fileToBuffer(char* file);
+    char* fileToBuffer(const char* file);
 
 namespace KTX {
 
@@ -0,0 +1,244 @@
+#include "debugoutput.h"
+
+#include <stdio.h>
+#include <string.h>
+
+namespace GL {
+
+    static const char* sourceName(GLenum source) {
+        switch (source) {
+            case GL_DEBUG_SOURCE_API:               return "API";
+            case GL_DEBUG_SOURCE_WINDOW_SYSTEM:     return "window system";
+            case GL_DEBUG_SOURCE_SHADER_COMPILER:   return "shader compiler";
+            case GL_DEBUG_SOURCE_THIRD_PARTY:       return "third party";
+            case GL_DEBUG_SOURCE_APPLICATION:       return "application";
+        }
+        return "other";
+    }
+
+    static const char* typeName(GLenum type) {
+        switch (type) {
+            case GL_DEBUG_TYPE_ERROR:               return "error";
+            case GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR: return "deprecated";
+            case GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR:  return "undefined behavior";
+            case GL_DEBUG_TYPE_PORTABILITY:         return "portability";
+            case GL_DEBUG_TYPE_PERFORMANCE:         return "performance";
+            case GL_DEBUG_TYPE_MARKER:              return "marker";
+            case GL_DEBUG_TYPE_PUSH_GROUP:          return "push group";
+            case GL_DEBUG_TYPE_POP_GROUP:           return "pop group";
+        }
+        return "other";
+    }
+
+    static const char* severityName(GLenum severity) {
+        switch (severity) {
+            case GL_DEBUG_SEVERITY_HIGH:            return "high";
+            case GL_DEBUG_SEVERITY_MEDIUM:          return "medium";
+            case GL_DEBUG_SEVERITY_LOW:             return "low";
+        }
+        return "notification";
+    }
+
+
+    // Public
+
+    DebugOutput::DebugOutput()
+        : _head(0), _tail(0), _dropped(0), _installed(false), _frame(0), _errors(0), _performance(0)
+    {
+        _slots = new Slot[CAPACITY];
+        for (size_t i = 0; i < CAPACITY; i++) {
+            _slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    // The context may already be gone here, so no GL calls; uninstall() first.
+    DebugOutput::~DebugOutput() {
+        delete[] _slots;
+    }
+
+    bool DebugOutput::isSupported() {
+        return GLEW_VERSION_4_3 || GLEW_KHR_debug;
+    }
+
+    void DebugOutput::label(GLenum identifier, GLuint name, const char* text) {
+        if (name != 0 && isSupported()) {
+            glObjectLabel(identifier, name, -1, text);
+        }
+    }
+
+    bool DebugOutput::install(bool synchronous) {
+        if (!isSupported()) {
+            printf("KHR_debug is not supported, GL debug output is off\n");
+            return false;
+        }
+
+        GLint flags = 0;
+        glGetIntegerv(GL_CONTEXT_FLAGS, &flags);
+        if (!(flags & GL_CONTEXT_FLAG_DEBUG_BIT)) {
+            printf("Not a debug context, the driver may report less\n");
+        }
+
+        glEnable(GL_DEBUG_OUTPUT);
+        if (synchronous) {
+            glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+        } else {
+            glDisable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+        }
+
+        glDebugMessageCallback(callback, this);
+        glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DONT_CARE, 0, NULL, GL_TRUE);
+        glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DEBUG_SEVERITY_NOTIFICATION, 0, NULL, GL_FALSE);
+
+        printf("Installing GL debug output (%s)\n", synchronous ? "synchronous" : "asynchronous");
+        _installed = true;
+        return true;
+    }
+
+    void DebugOutput::uninstall() {
+        if (!_installed) {
+            return;
+        }
+
+        glDebugMessageCallback(NULL, NULL);
+        glDisable(GL_DEBUG_OUTPUT);
+        _installed = false;
+        drain();
+    }
+
+    /**
+     * A bounded multi-producer ring: each slot's sequence number says whether
+     * it is free for the producer claiming position `pos` (sequence == pos),
+     * or holds a message for the consumer (sequence == pos + 1). Producers
+     * claim positions with a compare-and-swap on `_head` and never wait.
+     */
+    void DebugOutput::post(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length, const GLchar* text) {
+        size_t pos = _head.load(std::memory_order_relaxed);
+        Slot* slot;
+
+        for (;;) {
+            slot = &_slots[pos & (CAPACITY - 1)];
+            size_t sequence = slot->sequence.load(std::memory_order_acquire);
+            ptrdiff_t difference = (ptrdiff_t)sequence - (ptrdiff_t)pos;
+
+            if (difference == 0) {
+                if (_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (difference < 0) {
+                // Full: the consumer hasn't got to this slot yet
+                _dropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            } else {
+                pos = _head.load(std::memory_order_relaxed);
+            }
+        }
+
+        DebugMessage& message = slot->message;
+        message.source = source;
+        message.type = type;
+        message.id = id;
+        message.severity = severity;
+
+        size_t size = length < 0 ? strlen(text) : (size_t)length;
+        if (size > sizeof(message.text) - 1) {
+            size = sizeof(message.text) - 1;
+        }
+        memcpy(message.text, text, size);
+        message.text[size] = '\0';
+
+        slot->sequence.store(pos + 1, std::memory_order_release);
+    }
+
+    size_t DebugOutput::drain() {
+        size_t drained = 0;
+
+        for (;;) {
+            Slot& slot = _slots[_tail & (CAPACITY - 1)];
+            if (slot.sequence.load(std::memory_order_acquire) != _tail + 1) {
+                break;
+            }
+
+            DebugMessage message = slot.message;
+            slot.sequence.store(_tail + CAPACITY, std::memory_order_release);
+            _tail++;
+
+            route(message);
+            drained++;
+        }
+
+        return drained;
+    }
+
+    void DebugOutput::endFrame() {
+        drain();
+
+        if (!_warnings.empty()) {
+            unsigned int total = 0;
+            for (size_t i = 0; i < _warnings.size(); i++) {
+                total += _warnings[i].count;
+            }
+
+            printf("GL performance warnings in frame %lu: %u\n", _frame, total);
+            for (size_t i = 0; i < _warnings.size(); i++) {
+                printf("    %ux %s %u: %s\n", _warnings[i].count, sourceName(_warnings[i].source),
+                       _warnings[i].id, _warnings[i].text.c_str());
+            }
+            _warnings.clear();
+        }
+
+        unsigned long dropped = _dropped.exchange(0, std::memory_order_relaxed);
+        if (dropped) {
+            fprintf(stderr, "GL debug output: %lu messages dropped, the ring was full\n", dropped);
+        }
+
+        _frame++;
+    }
+
+    unsigned long DebugOutput::errors() const {
+        return _errors;
+    }
+
+    unsigned long DebugOutput::performanceWarnings() const {
+        return _performance;
+    }
+
+    unsigned long DebugOutput::dropped() const {
+        return _dropped.load(std::memory_order_relaxed);
+    }
+
+
+    // Private
+
+    void GLAPIENTRY DebugOutput::callback(GLenum source, GLenum type, GLuint id, GLenum severity,
+                                          GLsizei length, const GLchar* message, const void* userParam) {
+        ((DebugOutput*)userParam)->post(source, type, id, severity, length, message);
+    }
+
+    void DebugOutput::route(const DebugMessage& message) {
+        if (message.type == GL_DEBUG_TYPE_ERROR || message.severity == GL_DEBUG_SEVERITY_HIGH) {
+            _errors++;
+            fprintf(stderr, "GL %s (%s, %s severity) %u: %s\n", typeName(message.type),
+                    sourceName(message.source), severityName(message.severity), message.id, message.text);
+            return;
+        }
+
+        if (message.type == GL_DEBUG_TYPE_PERFORMANCE) {
+            _performance++;
+
+            // Drivers repeat the same warning for every offending call
+            for (size_t i = 0; i < _warnings.size(); i++) {
+                if (_warnings[i].id == message.id && _warnings[i].source == message.source) {
+                    _warnings[i].count++;
+                    return;
+                }
+            }
+
+            Warning warning = { message.source, message.id, 1, message.text };
+            _warnings.push_back(warning);
+            return;
+        }
+
+        printf("GL %s (%s, %s severity) %u: %s\n", typeName(message.type),
+               sourceName(message.source), severityName(message.severity), message.id, message.text);
+    }
+}
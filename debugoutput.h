@@ -0,0 +1,103 @@
+#ifndef DEBUGOUTPUT_H
+#define DEBUGOUTPUT_H
+
+#include <GL/glew.h>
+#include <atomic>
+#include <string>
+#include <vector>
+
+namespace GL {
+
+    // A message as reported by the driver, truncated to fit a ring slot
+    struct DebugMessage
+    {
+        GLenum  source;
+        GLenum  type;
+        GLuint  id;
+        GLenum  severity;
+        char    text[256];
+    };
+
+    /**
+     * KHR_debug output, kept off the render thread's hot path.
+     *
+     * The driver may call back at any time and, unless the output is
+     * synchronous, from its own threads. The callback therefore only copies
+     * the message into a fixed-size lock-free ring; nothing is printed until
+     * drain() runs, once per frame after the swap. Messages that arrive while
+     * the ring is full are counted and dropped.
+     *
+     * Draining routes messages by type and severity: errors and high severity
+     * messages go to stderr, performance warnings are tallied into a summary
+     * printed by endFrame(), and everything else is printed to stdout.
+     * Notifications are turned off at the source, as some drivers send one
+     * for every buffer they allocate.
+     */
+    class DebugOutput {
+    public:
+        DebugOutput();
+        ~DebugOutput();
+
+        // True if the current context has KHR_debug (core since GL 4.3)
+        static bool isSupported();
+
+        // Names a GL object in debug messages and in GL debuggers. `identifier`
+        // is e.g. GL_BUFFER, GL_TEXTURE or GL_PROGRAM. Does nothing without KHR_debug.
+        static void label(GLenum identifier, GLuint name, const char* text);
+
+        // Starts receiving messages. `synchronous` makes the driver report on
+        // the thread and in the call that caused them, which is slower but
+        // lets a debugger stop on the culprit. Returns false without KHR_debug.
+        bool install(bool synchronous = false);
+        void uninstall(); // Stops receiving messages, and drains what is left.
+
+        // Queues a message; safe to call from any thread
+        void post(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length, const GLchar* text);
+
+        size_t drain(); // Routes every queued message. Returns how many there were.
+        void endFrame(); // Drains, then prints and resets the frame's performance summary.
+
+        unsigned long errors() const; // Errors and high severity messages drained so far
+        unsigned long performanceWarnings() const; // Performance messages drained so far
+        unsigned long dropped() const; // Messages lost to a full ring
+
+    private:
+        static const size_t CAPACITY = 256;     // Ring slots; a power of two
+
+        struct Slot
+        {
+            std::atomic<size_t> sequence;       // Tells producers and the consumer whose turn it is
+            DebugMessage        message;
+        };
+
+        // One distinct performance warning seen this frame
+        struct Warning
+        {
+            GLenum          source;
+            GLuint          id;
+            unsigned int    count;
+            std::string     text;
+        };
+
+        static void GLAPIENTRY callback(GLenum source, GLenum type, GLuint id, GLenum severity,
+                                        GLsizei length, const GLchar* message, const void* userParam);
+
+        void route(const DebugMessage& message);
+
+        Slot* _slots;
+        std::atomic<size_t> _head;              // Next slot to claim, shared by producers
+        size_t _tail;                           // Next slot to drain, owned by the consumer
+        std::atomic<unsigned long> _dropped;
+
+        bool _installed;
+        unsigned long _frame;
+        unsigned long _errors;
+        unsigned long _performance;
+        std::vector<Warning> _warnings;         // This frame's performance warnings
+
+        DebugOutput(const DebugOutput&);
+        DebugOutput& operator=(const DebugOutput&);
+    };
+}
+
+#endif
@@ -0,0 +1,243 @@
+#include "framescheduler.h"
+
+#include <stdio.h>
+#include <thread>
+
+namespace GL {
+
+    // Closer than this to a wake-up, yield instead of sleeping: OS timers
+    // can overshoot by a millisecond or more
+    static const double SPIN_SECONDS = 0.002;
+
+    // Weight of the newest sample in the smoothed stats
+    static const double SMOOTHING = 0.1;
+
+    // Frames in a row needed before the swap interval changes
+    static const int ADAPT_FRAMES = 8;
+
+    static double smooth(double average, double sample, bool first) {
+        return first ? sample : average + (sample - average) * SMOOTHING;
+    }
+
+
+    // Public
+
+    FrameScheduler::FrameScheduler()
+        : _wait(NULL), _waitData(NULL), _swapInterval(NULL), _swapIntervalData(NULL), _clock(NULL), _clockData(NULL),
+          _period(0.0), _refreshPeriod(1.0 / 60.0), _adaptive(false), _tearing(false), _animating(false),
+          _dirty(DIRTY_ALL), _inputPending(false), _inputTime(0.0), _frameHasInput(false),
+          _deadline(0.0), _frameStart(0.0), _swapStart(0.0), _lastSwapEnd(0.0), _slowFrames(0), _fastFrames(0)
+    {
+        FrameStats zero = { 0 };
+        _stats = zero;
+        _stats.swapInterval = 1;
+    }
+
+    void FrameScheduler::setWait(WaitFn fn, void* userData) {
+        _wait = fn;
+        _waitData = userData;
+    }
+
+    void FrameScheduler::setSwapInterval(SwapIntervalFn fn, void* userData) {
+        _swapInterval = fn;
+        _swapIntervalData = userData;
+    }
+
+    void FrameScheduler::setClock(ClockFn fn, void* userData) {
+        _clock = fn;
+        _clockData = userData;
+    }
+
+    void FrameScheduler::setTargetFps(double fps) {
+        _period = fps > 0.0 ? 1.0 / fps : 0.0;
+    }
+
+    void FrameScheduler::setRefreshRate(double hz) {
+        if (hz > 0.0) {
+            _refreshPeriod = 1.0 / hz;
+        }
+    }
+
+    void FrameScheduler::setAdaptiveVsync(bool enabled, bool tearing) {
+        _adaptive = enabled;
+        _tearing = tearing;
+        _slowFrames = _fastFrames = 0;
+
+        if (!enabled && _stats.swapInterval != 1) {
+            applySwapInterval(1);
+        }
+    }
+
+    void FrameScheduler::setAnimating(bool animating) {
+        _animating = animating;
+    }
+
+    bool FrameScheduler::isAnimating() const {
+        return _animating;
+    }
+
+    void FrameScheduler::invalidate(unsigned int flags) {
+        _dirty |= flags;
+    }
+
+    void FrameScheduler::input(unsigned int flags) {
+        if (!_inputPending) {
+            _inputPending = true;
+            _inputTime = now();
+        }
+        invalidate(flags);
+    }
+
+    unsigned int FrameScheduler::waitForFrame() {
+        if ((_dirty | (_animating ? DIRTY_ANIMATION : 0)) == DIRTY_NONE) {
+            // Nothing to draw: sleep until the window system has news
+            wait(-1.0);
+            return DIRTY_NONE;
+        }
+
+        if (_period > 0.0) {
+            double start = now();
+            double frameTime = _stats.frameMs / 1000.0;
+
+            if (_deadline < start) {
+                // Behind, or waking up from idle: draw right away
+                _deadline = start + frameTime;
+            } else {
+                // Start early by the time a frame takes, swap included,
+                // so the swap ends on the deadline
+                double wake = _deadline - frameTime;
+                double remaining = wake - start;
+
+                if (remaining > SPIN_SECONDS) {
+                    wait(remaining - SPIN_SECONDS);
+                    return DIRTY_NONE;
+                }
+                while (now() < wake) {
+                    std::this_thread::yield();
+                }
+            }
+        }
+
+        // Pick up anything that arrived while the last frame was drawn
+        wait(0.0);
+
+        unsigned int dirty = _dirty | (_animating ? DIRTY_ANIMATION : 0);
+        _dirty = DIRTY_NONE;
+        _frameHasInput = _inputPending;
+        _frameStart = now();
+        return dirty;
+    }
+
+    void FrameScheduler::beginSwap() {
+        _swapStart = now();
+    }
+
+    void FrameScheduler::endSwap() {
+        double end = now();
+        bool first = _stats.frames == 0;
+
+        double frame = end - _frameStart;
+        double work = _swapStart - _frameStart;
+        _stats.frameMs = smooth(_stats.frameMs, frame * 1000.0, first);
+        _stats.swapMs = smooth(_stats.swapMs, (end - _swapStart) * 1000.0, first);
+        // Time blocked in a vsynced swap is the display's, not ours
+        _stats.busySeconds += work;
+
+        if (_frameHasInput) {
+            double latency = (end - _inputTime) * 1000.0;
+            _stats.inputLatencyMs = smooth(_stats.inputLatencyMs, latency, _stats.maxInputLatencyMs == 0.0);
+            if (latency > _stats.maxInputLatencyMs) {
+                _stats.maxInputLatencyMs = latency;
+            }
+            _inputPending = false;
+            _frameHasInput = false;
+        }
+
+        // Late against the pacer's deadline, or, when vsync paces, more than a
+        // vertical blank between two back-to-back frames
+        bool late;
+        if (_period > 0.0) {
+            late = !first && end - _deadline > _period * 0.25;
+            _deadline += _period;
+        } else {
+            bool backToBack = !first && _frameStart - _lastSwapEnd < _refreshPeriod * 0.25;
+            late = backToBack && end - _lastSwapEnd > _refreshPeriod * 1.5;
+        }
+
+        if (late) {
+            _stats.missed++;
+        }
+        if (_adaptive) {
+            adaptSwapInterval(late, work);
+        }
+
+        _stats.frames++;
+        _lastSwapEnd = end;
+    }
+
+    const FrameStats& FrameScheduler::stats() const {
+        return _stats;
+    }
+
+    void FrameScheduler::logStats() const {
+        double total = _stats.idleSeconds + _stats.busySeconds;
+        printf("Frames: %lu (%lu missed), frame: %.2f ms, swap: %.2f ms, idle: %.1f%%, "
+               "input latency: %.2f ms (max %.2f ms), swap interval: %i\n",
+               _stats.frames, _stats.missed, _stats.frameMs, _stats.swapMs,
+               total > 0.0 ? 100.0 * _stats.idleSeconds / total : 100.0,
+               _stats.inputLatencyMs, _stats.maxInputLatencyMs, _stats.swapInterval);
+    }
+
+
+    // Private
+
+    double FrameScheduler::now() const {
+        if (_clock) {
+            return _clock(_clockData);
+        }
+        return std::chrono::duration<double>(Clock::now().time_since_epoch()).count();
+    }
+
+    void FrameScheduler::wait(double timeout) {
+        double start = now();
+
+        if (_wait) {
+            _wait(timeout, _waitData);
+        } else if (timeout > 0.0) {
+            std::this_thread::sleep_for(std::chrono::duration<double>(timeout));
+        }
+
+        _stats.idleSeconds += now() - start;
+    }
+
+    void FrameScheduler::applySwapInterval(int interval) {
+        printf("Setting swap interval: %i\n", interval);
+        if (_swapInterval) {
+            _swapInterval(interval, _swapIntervalData);
+        }
+        _stats.swapInterval = interval;
+    }
+
+    /**
+     * Leaves vsync when frames keep missing vertical blank, so a frame that is
+     * slightly too slow shows up late (and tears) instead of waiting a whole
+     * extra refresh. Goes back to vsync once the work before the swap fits well
+     * inside a refresh again; that has to be judged from the work alone, as a
+     * vsynced swap always takes up the rest of the refresh.
+     */
+    void FrameScheduler::adaptSwapInterval(bool late, double workSeconds) {
+        if (_stats.swapInterval == 1) {
+            _slowFrames = late ? _slowFrames + 1 : 0;
+            if (_slowFrames >= ADAPT_FRAMES) {
+                applySwapInterval(_tearing ? -1 : 0);
+                _slowFrames = _fastFrames = 0;
+            }
+        } else {
+            _fastFrames = workSeconds < _refreshPeriod * 0.75 ? _fastFrames + 1 : 0;
+            if (_fastFrames >= ADAPT_FRAMES) {
+                applySwapInterval(1);
+                _slowFrames = _fastFrames = 0;
+            }
+        }
+    }
+}
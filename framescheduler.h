@@ -0,0 +1,130 @@
+#ifndef FRAMESCHEDULER_H
+#define FRAMESCHEDULER_H
+
+#include <chrono>
+
+namespace GL {
+
+    // What changed since the last frame. Input callbacks set these through
+    // FrameScheduler::invalidate(); a frame is only rendered when one is set.
+    enum DirtyFlags
+    {
+        DIRTY_NONE      = 0,
+        DIRTY_SCENE     = 1 << 0,   // Objects or their constants changed
+        DIRTY_VIEW      = 1 << 1,   // Camera moved
+        DIRTY_RESIZE    = 1 << 2,   // Framebuffer size changed
+        DIRTY_EXPOSE    = 1 << 3,   // Window contents were damaged and need redrawing
+        DIRTY_ANIMATION = 1 << 4,   // Set on every frame while animating
+        DIRTY_ALL       = 0xFF
+    };
+
+    struct FrameStats
+    {
+        unsigned long   frames;             // Frames rendered
+        unsigned long   missed;             // Frames whose swap finished after their deadline
+        double          idleSeconds;        // Time blocked waiting for events or the next deadline
+        double          busySeconds;        // Time from frame start to the swap call
+        double          frameMs;            // Smoothed frame start to swap completion
+        double          swapMs;             // Smoothed time spent inside the swap
+        double          inputLatencyMs;     // Smoothed first input to swap completion
+        double          maxInputLatencyMs;
+        int             swapInterval;       // Interval currently in effect
+    };
+
+    /**
+     * Decides when the main loop renders.
+     *
+     * Nothing is drawn unless something is dirty: with no animation running,
+     * waitForFrame() blocks in the window system until an event arrives, so an
+     * unchanged window costs no CPU or GPU time at all. While there is work,
+     * frames are paced to the target frame rate. The pacer starts each frame
+     * early by the measured frame time, swap included, so the swap completes
+     * on its deadline. It sleeps in the window system's wait for the bulk of
+     * the gap and yields for the last moment, where the OS timer is too coarse.
+     *
+     * With adaptive vsync enabled the swap interval drops to late-swap tearing
+     * (or to 0 without it) when frames keep missing vertical blank, and goes
+     * back to 1 once they fit comfortably again.
+     *
+     * The scheduler knows nothing about the window system; waiting and setting
+     * the swap interval go through callbacks (see main.cpp for GLFW). So does
+     * reading the time, for tests that need a clock of their own.
+     */
+    class FrameScheduler {
+    public:
+        // Blocks until an event arrives or `timeout` seconds pass.
+        // A negative timeout waits indefinitely; 0 only polls.
+        typedef void (*WaitFn)(double timeout, void* userData);
+        typedef void (*SwapIntervalFn)(int interval, void* userData);
+        // Returns the current time in seconds, from any fixed starting point
+        typedef double (*ClockFn)(void* userData);
+
+        FrameScheduler();
+
+        void setWait(WaitFn fn, void* userData);
+        void setSwapInterval(SwapIntervalFn fn, void* userData);
+        void setClock(ClockFn fn, void* userData); // Defaults to std::chrono::steady_clock.
+
+        // Frames per second to pace to; 0 leaves pacing to vsync
+        void setTargetFps(double fps);
+        // Display refresh rate, used to spot frames that miss vertical blank
+        void setRefreshRate(double hz);
+        // Lets the swap interval follow the frame rate; `tearing` says whether
+        // late swaps may tear (EXT_swap_control_tear)
+        void setAdaptiveVsync(bool enabled, bool tearing);
+        // Keeps every frame dirty, for continuous animation
+        void setAnimating(bool animating);
+        bool isAnimating() const;
+
+        void invalidate(unsigned int flags = DIRTY_ALL);
+        // Records user input; the time until it reaches the screen is tracked
+        void input(unsigned int flags = DIRTY_SCENE);
+
+        // Waits once and returns the dirty flags to render, or DIRTY_NONE if
+        // the loop should just check for exit and call again
+        unsigned int waitForFrame();
+
+        void beginSwap(); // Call right before swapping buffers...
+        void endSwap(); // ...and right after.
+
+        const FrameStats& stats() const;
+        void logStats() const;
+
+    private:
+        typedef std::chrono::steady_clock Clock;
+
+        double now() const;
+        void wait(double timeout);
+        void applySwapInterval(int interval);
+        void adaptSwapInterval(bool late, double workSeconds);
+
+        WaitFn _wait;
+        void* _waitData;
+        SwapIntervalFn _swapInterval;
+        void* _swapIntervalData;
+        ClockFn _clock;
+        void* _clockData;
+
+        double _period;             // Seconds per frame at the target rate, or 0
+        double _refreshPeriod;      // Seconds per vertical blank
+        bool _adaptive;
+        bool _tearing;
+        bool _animating;
+
+        unsigned int _dirty;
+        bool _inputPending;
+        double _inputTime;          // First input not yet on screen
+        bool _frameHasInput;
+
+        double _deadline;           // When the next swap should complete
+        double _frameStart;
+        double _swapStart;
+        double _lastSwapEnd;
+        int _slowFrames;            // Consecutive frames that missed vertical blank
+        int _fastFrames;            // Consecutive frames with plenty of room
+
+        FrameStats _stats;
+    };
+}
+
+#endif
@@ -0,0 +1,22 @@
+#version 410 core
+
+layout ( location = 0 ) in vec3 position;
+layout ( location = 1 ) in vec3 color;
+
+// Per-draw data, streamed each frame through GL::IndirectBuffer. Instanced
+// attributes, so that each draw's baseInstance picks its own.
+// Must stay in sync with `perDraw` in main.cpp.
+layout ( location = 2 ) in mat4 model;
+layout ( location = 6 ) in vec4 tint;
+
+
+out vec3 Color;
+
+
+
+void main()
+{
+    Color = color * tint.rgb;
+    gl_Position = model * vec4(position, 1.0f);
+
+}
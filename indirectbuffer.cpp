@@ -0,0 +1,294 @@
+#include "indirectbuffer.h"
+#include "debugoutput.h"
+
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+
+namespace GL {
+
+    // Fewer draws than this are filled on the render thread alone; waking
+    // the workers would cost more than it saves
+    static const GLuint PARALLEL_FILL = 256;
+
+    // Regions start on an offset that suits both indirect commands and vertex attributes
+    static const GLsizeiptr REGION_ALIGNMENT = 256;
+
+    static GLsizeiptr alignUp(GLsizeiptr value, GLsizeiptr alignment) {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+
+    // Public
+
+    IndirectBuffer::IndirectBuffer()
+        : _handle(0), _capacity(0), _indexed(false), _commandSize(0), _drawDataSize(0),
+          _dataOffset(0), _regionSize(0), _framesInFlight(0), _frame(0), _fences(NULL),
+          _multiDraw(false), _persistent(false), _mapping(NULL),
+          _generation(0), _pending(0), _quit(false), _fill(NULL), _fillData(NULL),
+          _fillCount(0), _commands(NULL), _drawData(NULL) {}
+
+    IndirectBuffer::~IndirectBuffer() {
+        destroy();
+    }
+
+    /**
+     * Creates the buffer, persistently mapped where the GL allows it, and
+     * starts the workers. Each region holds the commands, then the per-draw data.
+     */
+    void IndirectBuffer::create(GLuint capacity, bool indexed, GLsizei drawDataSize,
+                                GLuint framesInFlight, unsigned int workers, bool persistent) {
+        destroy();
+
+        _capacity = capacity;
+        _indexed = indexed;
+        _commandSize = indexed ? sizeof(DrawElementsIndirectCommand) : sizeof(DrawArraysIndirectCommand);
+        _drawDataSize = drawDataSize;
+        _dataOffset = alignUp((GLsizeiptr)_commandSize * capacity, REGION_ALIGNMENT);
+        _regionSize = alignUp(_dataOffset + (GLsizeiptr)drawDataSize * capacity, REGION_ALIGNMENT);
+        _framesInFlight = framesInFlight > 0 ? framesInFlight : 1;
+        _frame = 0;
+
+        _fences = new GLsync[_framesInFlight];
+        memset(_fences, 0, sizeof(GLsync) * _framesInFlight);
+
+        _multiDraw = isMultiDrawSupported();
+        _persistent = persistent && (GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage);
+
+        GLsizeiptr size = _regionSize * _framesInFlight;
+        glGenBuffers(1, &_handle);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, _handle);
+
+        if (_persistent) {
+            GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            glBufferStorage(GL_DRAW_INDIRECT_BUFFER, size, NULL, flags);
+            _mapping = (unsigned char*)glMapBufferRange(GL_DRAW_INDIRECT_BUFFER, 0, size, flags);
+        } else {
+            glBufferData(GL_DRAW_INDIRECT_BUFFER, size, NULL, GL_STREAM_DRAW);
+        }
+        DebugOutput::label(GL_BUFFER, _handle, "Indirect draws");
+
+        _quit = false;
+        for (unsigned int i = 0; i < workers; i++) {
+            _workers.push_back(std::thread(&IndirectBuffer::worker, this, i + 1));
+        }
+
+        printf("Creating indirect buffer: %i regions of %u draws (%s, %s, %u workers) ID: %i\n",
+               _framesInFlight, _capacity, _multiDraw ? "multi-draw" : "one call per draw",
+               _persistent ? "persistently mapped" : "mapped per frame", (unsigned)_workers.size(), _handle);
+    }
+
+    void IndirectBuffer::destroy() {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _quit = true;
+        }
+        _wake.notify_all();
+
+        for (size_t i = 0; i < _workers.size(); i++) {
+            _workers[i].join();
+        }
+        _workers.clear();
+        _generation = 0;
+
+        if (_fences) {
+            for (GLuint i = 0; i < _framesInFlight; i++) {
+                if (_fences[i]) {
+                    glDeleteSync(_fences[i]);
+                }
+            }
+        }
+        if (_handle) {
+            // Deleting the buffer unmaps it, too
+            glDeleteBuffers(1, &_handle);
+            _handle = 0;
+        }
+
+        delete[] _fences;
+        _fences = NULL;
+        _mapping = NULL;
+    }
+
+    GLuint IndirectBuffer::getHandle() {
+        return _handle;
+    }
+
+    bool IndirectBuffer::isMultiDrawSupported() {
+        return GLEW_VERSION_4_3 || (GLEW_ARB_multi_draw_indirect && GLEW_ARB_base_instance);
+    }
+
+    void IndirectBuffer::setMultiDraw(bool enabled) {
+        _multiDraw = enabled && isMultiDrawSupported();
+    }
+
+    bool IndirectBuffer::isMultiDraw() const {
+        return _multiDraw;
+    }
+
+    bool IndirectBuffer::isPersistent() const {
+        return _persistent;
+    }
+
+    void IndirectBuffer::beginFrame() {
+        _frame = (_frame + 1) % _framesInFlight;
+
+        GLsync fence = _fences[_frame];
+        if (fence) {
+            // Only blocks when the CPU is more than `framesInFlight` frames ahead
+            GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+            while (result == GL_TIMEOUT_EXPIRED) {
+                result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+            }
+            glDeleteSync(fence);
+            _fences[_frame] = 0;
+        }
+
+        // The fence already guarantees the GPU is done with the region
+        if (!_persistent) {
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, _handle);
+            _mapping = (unsigned char*)glMapBufferRange(GL_DRAW_INDIRECT_BUFFER, _frame * _regionSize, _regionSize,
+                GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+        }
+    }
+
+    void IndirectBuffer::endFrame() {
+        unmap();
+        _fences[_frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    /**
+     * Hands one slice of the draws to each worker, fills the first slice
+     * itself and waits for the rest. Must be called once a frame, before
+     * the frame's first submit().
+     */
+    GLuint IndirectBuffer::fill(GLuint count, FillFn fill, void* userData) {
+        if (!_mapping) {
+            fprintf(stderr, "Indirect buffer %i is not mapped; fill() must follow beginFrame()\n", _handle);
+            return 0;
+        }
+
+        unsigned char* region = _persistent ? _mapping + _frame * _regionSize : _mapping;
+
+        _fill = fill;
+        _fillData = userData;
+        _fillCount = std::min(count, _capacity);
+        _commands = region;
+        _drawData = region + _dataOffset;
+
+        if (_fillCount < PARALLEL_FILL || _workers.empty()) {
+            fillSlice(0);
+        } else {
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _generation++;
+                _pending = (unsigned int)_workers.size();
+            }
+            _wake.notify_all();
+
+            fillSlice(0);
+
+            std::unique_lock<std::mutex> lock(_mutex);
+            _done.wait(lock, [this] { return _pending == 0; });
+        }
+
+        unmap();
+        return _fillCount;
+    }
+
+    GLintptr IndirectBuffer::commandOffset(GLuint draw) const {
+        return _frame * _regionSize + (GLintptr)draw * _commandSize;
+    }
+
+    GLintptr IndirectBuffer::drawDataOffset(GLuint draw) const {
+        return _frame * _regionSize + _dataOffset + (GLintptr)draw * _drawDataSize;
+    }
+
+    void IndirectBuffer::submit(GLenum mode, GLuint first, GLuint count, DrawFn perDraw, void* userData) {
+        unmap();
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, _handle);
+
+        GLintptr offset = commandOffset(first);
+
+        if (_multiDraw) {
+            if (_indexed) {
+                glMultiDrawElementsIndirect(mode, GL_UNSIGNED_INT, (void*)offset, count, 0);
+            } else {
+                glMultiDrawArraysIndirect(mode, (void*)offset, count, 0);
+            }
+            return;
+        }
+
+        for (GLuint i = 0; i < count; i++) {
+            if (perDraw) {
+                perDraw(first + i, drawDataOffset(first + i), userData);
+            }
+
+            void* command = (void*)(offset + (GLintptr)i * _commandSize);
+            if (_indexed) {
+                glDrawElementsIndirect(mode, GL_UNSIGNED_INT, command);
+            } else {
+                glDrawArraysIndirect(mode, command);
+            }
+        }
+    }
+
+
+    // Private
+
+    void IndirectBuffer::worker(unsigned int slice) {
+        unsigned long seen = 0;
+
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _wake.wait(lock, [this, seen] { return _quit || _generation != seen; });
+                if (_quit) {
+                    return;
+                }
+                seen = _generation;
+            }
+
+            fillSlice(slice);
+
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (--_pending == 0) {
+                _done.notify_one();
+            }
+        }
+    }
+
+    /**
+     * Fills slice `slice` of the current fill(). On the fallback path the
+     * commands' baseInstance is cleared, since GL 4.1 requires it to be 0.
+     */
+    void IndirectBuffer::fillSlice(unsigned int slice) {
+        GLuint slices = _fillCount < PARALLEL_FILL ? 1 : (GLuint)_workers.size() + 1;
+        GLuint perSlice = (_fillCount + slices - 1) / slices;
+        GLuint first = slice * perSlice;
+
+        if (first >= _fillCount) {
+            return;
+        }
+        GLuint count = std::min(perSlice, _fillCount - first);
+
+        _fill(_commands, _drawData, first, count, _fillData);
+
+        if (!_multiDraw) {
+            for (GLuint i = first; i < first + count; i++) {
+                if (_indexed) {
+                    ((DrawElementsIndirectCommand*)_commands)[i].baseInstance = 0;
+                } else {
+                    ((DrawArraysIndirectCommand*)_commands)[i].baseInstance = 0;
+                }
+            }
+        }
+    }
+
+    void IndirectBuffer::unmap() {
+        if (!_persistent && _mapping) {
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, _handle);
+            glUnmapBuffer(GL_DRAW_INDIRECT_BUFFER);
+            _mapping = NULL;
+        }
+    }
+}
@@ -0,0 +1,127 @@
+#ifndef INDIRECTBUFFER_H
+#define INDIRECTBUFFER_H
+
+#include <GL/glew.h>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace GL {
+
+    // The command layouts GL_DRAW_INDIRECT_BUFFER holds
+    struct DrawArraysIndirectCommand
+    {
+        GLuint  count;
+        GLuint  instanceCount;
+        GLuint  first;
+        GLuint  baseInstance;
+    };
+
+    struct DrawElementsIndirectCommand
+    {
+        GLuint  count;
+        GLuint  instanceCount;
+        GLuint  firstIndex;
+        GLint   baseVertex;
+        GLuint  baseInstance;
+    };
+
+    /**
+     * Draw commands built on worker threads and drawn with a handful of
+     * glMultiDraw*Indirect calls.
+     *
+     * Each frame, fill() splits the draws into one slice per thread; every
+     * thread writes its commands, and `drawDataSize` bytes of per-draw data
+     * for each, straight into the mapped buffer. submit() then draws any run
+     * of them with a single call, so the render thread's cost hardly depends
+     * on how many objects there are. A draw's baseInstance is its index in
+     * the frame, for instanced attributes to find its data by.
+     *
+     * Like UniformRing, the buffer is split into `framesInFlight` regions
+     * guarded by fences. It stays mapped where buffer storage is available,
+     * and is mapped for each frame's fill() elsewhere.
+     *
+     * Without multi-draw indirect (GL 4.1), submit() falls back to one
+     * glDraw*Indirect per command. Since baseInstance must then be 0, it is
+     * cleared, and a callback points the draw's attributes at its data.
+     */
+    class IndirectBuffer {
+    public:
+        // Writes commands [first, first + count), and their per-draw data, into
+        // arrays that start at the frame's first draw. Runs on several threads at once.
+        typedef void (*FillFn)(void* commands, void* drawData, GLuint first, GLuint count, void* userData);
+
+        // Called before each draw on the fallback path, with where its data is in the buffer
+        typedef void (*DrawFn)(GLuint draw, GLintptr drawDataOffset, void* userData);
+
+        IndirectBuffer();
+        ~IndirectBuffer();
+
+        // Allocates room for `capacity` draws a frame, of DrawElementsIndirectCommand
+        // if `indexed` and DrawArraysIndirectCommand otherwise, and starts `workers` threads.
+        // Without `persistent`, the buffer is mapped each frame even where buffer
+        // storage is available, as on GL 4.1; tests use it to cover that path.
+        void create(GLuint capacity, bool indexed, GLsizei drawDataSize,
+                    GLuint framesInFlight = 3, unsigned int workers = 2, bool persistent = true);
+        void destroy(); // Stops the workers and releases the GL buffer and fences.
+
+        GLuint getHandle(); // Returns the ID referring to the buffer in the GL.
+
+        static bool isMultiDrawSupported(); // glMultiDraw*Indirect, with baseInstance
+        void setMultiDraw(bool enabled); // On where supported; off forces the fallback.
+        bool isMultiDraw() const;
+        bool isPersistent() const; // Mapped once, for good, rather than for each frame
+
+        void beginFrame(); // Moves to the next region, waiting for the GPU if it is still in use.
+        void endFrame(); // Fences the current region once the frame's draws are submitted.
+
+        // Fills the frame's first `count` draws, at most `capacity`, and returns how many
+        GLuint fill(GLuint count, FillFn fill, void* userData);
+
+        // Offsets of a draw's command and per-draw data in the buffer, for the current frame
+        GLintptr commandOffset(GLuint draw) const;
+        GLintptr drawDataOffset(GLuint draw) const;
+
+        // Draws commands [first, first + count) of the frame, with indices of type GL_UNSIGNED_INT
+        void submit(GLenum mode, GLuint first, GLuint count, DrawFn perDraw = NULL, void* userData = NULL);
+
+    private:
+        void worker(unsigned int slice);
+        void fillSlice(unsigned int slice);
+        void unmap();
+
+        GLuint _handle;
+        GLuint _capacity;
+        bool _indexed;
+        GLsizei _commandSize;
+        GLsizei _drawDataSize;
+        GLsizeiptr _dataOffset;     // Of the per-draw data within a region
+        GLsizeiptr _regionSize;
+        GLuint _framesInFlight;
+        GLuint _frame;              // Index of the region being written
+        GLsync* _fences;
+        bool _multiDraw;
+        bool _persistent;           // Mapped once, for good
+        unsigned char* _mapping;    // The whole buffer when persistent, else the current region
+
+        // Shared with the workers
+        std::mutex _mutex;
+        std::condition_variable _wake;
+        std::condition_variable _done;
+        std::vector<std::thread> _workers;
+        unsigned long _generation;  // Bumped for every fill() that uses the workers
+        unsigned int _pending;      // Workers still filling
+        bool _quit;
+        FillFn _fill;
+        void* _fillData;
+        GLuint _fillCount;
+        unsigned char* _commands;   // The frame's arrays, while filling
+        unsigned char* _drawData;
+
+        IndirectBuffer(const IndirectBuffer&);
+        IndirectBuffer& operator=(const IndirectBuffer&);
+    };
+}
+
+#endif
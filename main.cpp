@@ -2,13 +2,26 @@
 #define _USE_MATH_DEFINES
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <math.h>
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
 #include <thread>
+#include <vector>
+#include "debugoutput.h"
+#include "framescheduler.h"
+#include "indirectbuffer.h"
+#include "mesh.h"
+#include "meshlod.h"
+#include "scene.h"
+#include "scenestreamer.h"
 #include "shader.h"
+#include "std140.h"
+#include "uniformring.h"
 
 
 /////// Globals ///////
@@ -16,21 +29,53 @@ GLFWwindow* mWindow;
 GLuint program;
 GLuint vbo;     // Vertex Buffer Object
 GLuint vao;     // Vertex Array Object
+GLuint sceneProgram;    // Draws scene meshes with per-draw data from mIndirect
 
 GL::Shader mVertex, mGeometry, mFragment;
-
-struct vertexPosColor
-{
-    // Position
-    float x;
-    float y;
-    float z;
-
-    // color
-    float r;
-    float g;
-    float b;
-};
+GL::Shader mSceneVertex, mSceneFragment;
+GL::UniformRing mUniforms;  // Per-frame stream of per-object constants
+GL::FrameScheduler mScheduler;  // Decides when a frame is worth drawing
+GL::DebugOutput mDebug;     // Driver errors and performance warnings
+GL::Scene mScene;           // Optional scene file given on the command line
+GL::SceneStreamer mStreamer;    // Brings the scene's cells in around the eye
+GL::IndirectBuffer mIndirect;   // The scene's draws, built by worker threads
+float mEye[3] = { 0.0f, 0.0f, 0.0f };
+
+// Binding point of the `PerObject` uniform block in vertex.shader
+static const GLuint PER_OBJECT_BINDING = 0;
+
+// Frame rate that redraws are paced to; 0 leaves it to vsync
+static const double TARGET_FPS = 60.0;
+
+// Radians per second that the quad turns while animating
+static const double SPIN_SPEED = 1.0;
+
+// Scene streaming: cells within SCENE_LOAD_RADIUS of the eye are loaded, and
+// dropped again past SCENE_EVICT_RADIUS. At most SCENE_UPLOAD_BUDGET bytes go
+// to the GL per frame.
+static const float SCENE_LOAD_RADIUS = 64.0f;
+static const float SCENE_EVICT_RADIUS = 80.0f;
+static const size_t SCENE_UPLOAD_BUDGET = 4 * 1024 * 1024;
+
+// World units shown from the eye to the edge of the window at ground level,
+// and moved per arrow key press
+static const float SCENE_VIEW_EXTENT = 48.0f;
+static const float SCENE_PAN_STEP = 8.0f;
+
+// The scene camera's vertical field of view, in radians, and its clip planes
+static const float SCENE_FOV = 1.0471976f;
+static const float SCENE_NEAR = 1.0f;
+static const float SCENE_FAR = 1000.0f;
+
+// Picks each instance's level of detail for the framebuffer's height
+GL::Lod::Selector mLodSelector(SCENE_FOV, 1.0f);
+
+// Scene instances drawn per frame, at most, and the threads that build their draws
+static const GLuint SCENE_MAX_DRAWS = 64 * 1024;
+static const unsigned int SCENE_DRAW_WORKERS = 3;
+
+// Attribute location of the per-draw data in indirect.vertex.shader
+static const GLuint PER_DRAW_LOCATION = 2;
 
 static const vertexPosColor vertices[] = {
     -0.5f,  0.5f, 0.5f,   1.0f, 0.0f, 0.0f,  // Red vertex, top-left
@@ -41,6 +86,28 @@ static const vertexPosColor vertices[] = {
 
 
 
+// C++ mirror of the `PerObject` uniform block in vertex.shader
+struct perObject
+{
+    GL::Std140::mat4 model;
+    GL::Std140::vec4 tint;
+};
+
+GL_STD140_MEMBER(perObject, model);
+GL_STD140_MEMBER(perObject, tint);
+GL_STD140_OFFSET(perObject, tint, 64);
+GL_STD140_SIZE(perObject);
+
+
+// C++ mirror of the per-draw attributes in indirect.vertex.shader
+struct perDraw
+{
+    float model[16];
+    float tint[4];
+};
+
+
+
 static const GLfloat positions[] = {
     -1.0f, -1.0f, 0.5f,
     1.0f, -1.0f, 0.5f,
@@ -61,15 +128,54 @@ void errorCallback(int error, const char* description) {
 }
 
 // The key callback should handle any input,
-// To start, we'll just use the ESC key
+// ESC quits, SPACE starts and stops the quad spinning,
+// S prints the frame scheduler's stats and the arrow keys move over a scene
 void keyPressCallback(GLFWwindow* window, int key, int scancode, int action, int mods) {
-    if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS) {
+    bool pressed = action == GLFW_PRESS || action == GLFW_REPEAT;
+
+    if (pressed && (key == GLFW_KEY_LEFT || key == GLFW_KEY_RIGHT)) {
+        mEye[0] += key == GLFW_KEY_LEFT ? -SCENE_PAN_STEP : SCENE_PAN_STEP;
+        mScheduler.input(GL::DIRTY_VIEW);
+    } else if (pressed && (key == GLFW_KEY_UP || key == GLFW_KEY_DOWN)) {
+        mEye[2] += key == GLFW_KEY_UP ? -SCENE_PAN_STEP : SCENE_PAN_STEP;
+        mScheduler.input(GL::DIRTY_VIEW);
+    } else if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS) {
         glfwSetWindowShouldClose(window, GL_TRUE);
     } else if (key == GLFW_KEY_SPACE && action == GLFW_PRESS) {
-        return;
+        mScheduler.setAnimating(!mScheduler.isAnimating());
+        mScheduler.input();
+    } else if (key == GLFW_KEY_S && action == GLFW_PRESS) {
+        mScheduler.logStats();
     }
 }
 
+// Redraw when the window system says our contents were lost...
+void windowRefreshCallback(GLFWwindow* window) {
+    mScheduler.invalidate(GL::DIRTY_EXPOSE);
+}
+
+// ... or the framebuffer changes size
+void framebufferSizeCallback(GLFWwindow* window, int width, int height) {
+    glViewport(0, 0, width, height);
+    mLodSelector.setViewportHeight((float)height);
+    mScheduler.invalidate(GL::DIRTY_RESIZE);
+}
+
+// How the frame scheduler sleeps: in GLFW, so that input wakes it up
+void waitForEvents(double timeout, void* userData) {
+    if (timeout < 0.0) {
+        glfwWaitEvents();
+    } else if (timeout == 0.0) {
+        glfwPollEvents();
+    } else {
+        glfwWaitEventsTimeout(timeout);
+    }
+}
+
+void setSwapInterval(int interval, void* userData) {
+    glfwSwapInterval(interval);
+}
+
 
 /**
 * Helper function around creating a vertex attribute pointer for
@@ -82,7 +188,7 @@ void keyPressCallback(GLFWwindow* window, int key, int scancode, int action, int
 */
 void createVertexAttribPointerFromName(
     GLuint program,
-    char* attribName,
+    const char* attribName,
     GLenum type,
     GLboolean normalized,
     GLuint numItems,
@@ -99,7 +205,7 @@ void createVertexAttribPointerFromName(
             type,
             normalized,
             vertexElemLength,
-            (void*)(offset)
+            (void*)(size_t)(offset)
         );
 
         glEnableVertexAttribArray(attribIndex);
@@ -120,22 +226,210 @@ void createVertexAttribPointerFromLayoutPos(
         type,
         normalized,
         vertexElemLength,
-        (void*)(offset)
+        (void*)(size_t)(offset)
     );
 
     glEnableVertexAttribArray(layoutPosition);
 }
 
 
+/**
+* Draws the quad, turned by `angle` radians.
+*/
+void drawQuad(double angle) {
+    // Write every object's constants up front, then upload them
+    // all at once rather than with a glUniform* call per object
+    float c = (float)cos(angle);
+    float s = (float)sin(angle);
+    perObject object = {
+        {{ {   c,    s, 0.0f, 0.0f},
+           {  -s,    c, 0.0f, 0.0f},
+           {0.0f, 0.0f, 1.0f, 0.0f},
+           {0.0f, 0.0f, 0.0f, 1.0f} }},
+        {1.0f, 1.0f, 1.0f, 1.0f}
+    };
+    GLintptr objectOffset = mUniforms.push(object);
+    mUniforms.flush();
+
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    // A full ring has already logged; drawing would read another object's slice
+    if (objectOffset < 0) {
+        return;
+    }
+
+    // Point the block at this object's slice of the ring
+    mUniforms.bindRange<perObject>(PER_OBJECT_BINDING, objectOffset);
+
+    // Draw a rectangle from the 2 triangles using 6 indices
+    glDrawArrays(GL_TRIANGLES, 0, 6);
+}
+
+// What the workers building the scene's draws need to know about the frame
+struct sceneFrame
+{
+    float                   view[16];   // World to clip space
+    float                   eye[3];
+    float                   cullScale;  // Turns a radius into clip units from the side planes
+    std::vector<GLuint>     firstDraw;  // Of each resident cell, plus the total at the end
+};
+
+sceneFrame mSceneFrame;
+
+/**
+* Fills the draws for a slice of the resident instances: a command drawing
+* the level of detail of the instance's mesh that suits its distance from
+* the eye, or nothing if it is out of view, and its model matrix.
+* Runs on the indirect buffer's worker threads.
+*/
+void fillSceneDraws(void* commands, void* drawData, GLuint first, GLuint count, void* userData) {
+    const sceneFrame* frame = (const sceneFrame*)userData;
+    const std::vector<GLuint>& cells = mStreamer.residentCells();
+    GL::DrawElementsIndirectCommand* command = (GL::DrawElementsIndirectCommand*)commands;
+    perDraw* data = (perDraw*)drawData;
+
+    size_t c = std::upper_bound(frame->firstDraw.begin(), frame->firstDraw.end(), first) - frame->firstDraw.begin() - 1;
+
+    for (GLuint draw = first; draw < first + count; draw++) {
+        while (draw >= frame->firstDraw[c + 1]) {
+            c++;
+        }
+
+        const GL::SceneInstance& instance = mScene.instance(mScene.cell(cells[c]).firstInstance + draw - frame->firstDraw[c]);
+        const GL::SceneMesh& mesh = mScene.mesh(instance.mesh);
+        const GL::SceneStreamer::GpuMesh& gpuMesh = mStreamer.gpuMesh(instance.mesh);
+        const float* model = instance.model;
+
+        // Built on the stack: the mapping is write-only, and may be slow to read
+        float out[16];
+        for (int column = 0; column < 4; column++) {
+            for (int row = 0; row < 4; row++) {
+                out[column * 4 + row] =
+                    frame->view[row] * model[column * 4] + frame->view[4 + row] * model[column * 4 + 1] +
+                    frame->view[8 + row] * model[column * 4 + 2] + frame->view[12 + row] * model[column * 4 + 3];
+            }
+        }
+        perDraw values = { {}, { 1.0f, 1.0f, 1.0f, 1.0f } };
+        memcpy(values.model, out, sizeof(out));
+        data[draw] = values;
+
+        // Cull against the window with the bounding sphere, in clip space
+        const float* center = mesh.center;
+        float x = out[0] * center[0] + out[4] * center[1] + out[8] * center[2] + out[12];
+        float y = out[1] * center[0] + out[5] * center[1] + out[9] * center[2] + out[13];
+        float w = out[3] * center[0] + out[7] * center[1] + out[11] * center[2] + out[15];
+        float scale = sqrtf(model[0] * model[0] + model[1] * model[1] + model[2] * model[2]);
+        float radius = mesh.radius * scale;
+        float reach = radius * frame->cullScale;
+        bool visible = w > SCENE_NEAR - radius && fabsf(x) - w <= reach && fabsf(y) - w <= reach;
+
+        // The level's error is in object units, so measure the distance in them, too
+        float distance = 0.0f;
+        for (int k = 0; k < 3; k++) {
+            float d = model[k] * center[0] + model[4 + k] * center[1] + model[8 + k] * center[2] + model[12 + k] - frame->eye[k];
+            distance += d * d;
+        }
+        distance = std::max(sqrtf(distance) - radius, 0.0f) / std::max(scale, 1e-6f);
+        const GL::Lod::Level& level = mesh.levels[mLodSelector.select(mesh.levels, (int)mesh.levelCount, distance)];
+
+        // Levels index from the start of their mesh, wherever it was uploaded
+        GL::DrawElementsIndirectCommand drawCommand = {
+            (GLuint)level.indexCount, visible ? 1u : 0u, gpuMesh.firstIndex + level.firstIndex, gpuMesh.baseVertex, draw
+        };
+        command[draw] = drawCommand;
+    }
+}
+
+// Points the bound vertex array's per-draw attributes at the data starting at `offset`
+void pointPerDrawAttributes(GLintptr offset) {
+    glBindBuffer(GL_ARRAY_BUFFER, mIndirect.getHandle());
+    for (GLuint column = 0; column < 4; column++) {
+        createVertexAttribPointerFromLayoutPos(PER_DRAW_LOCATION + column, GL_FLOAT, GL_FALSE, 4, sizeof(perDraw), offset + column * 4 * sizeof(float));
+        glVertexAttribDivisor(PER_DRAW_LOCATION + column, 1);
+    }
+    createVertexAttribPointerFromLayoutPos(PER_DRAW_LOCATION + 4, GL_FLOAT, GL_FALSE, 4, sizeof(perDraw), offset + offsetof(perDraw, tint));
+    glVertexAttribDivisor(PER_DRAW_LOCATION + 4, 1);
+}
+
+// Without multi-draw, each draw finds its data by pointing the attributes at it
+void pointAtDraw(GLuint draw, GLintptr drawDataOffset, void* userData) {
+    pointPerDrawAttributes(drawDataOffset);
+}
+
+/**
+* Streams the scene around the eye and draws whatever of it is loaded,
+* looking straight down from the eye, in perspective, so that instances
+* further away are smaller and get coarser levels of detail.
+*
+* The draws are built by worker threads, and every mesh is in the
+* streamer's shared buffers, so the render thread submits the whole scene
+* at once however many cells, meshes and instances are resident.
+*/
+void drawScene() {
+    mStreamer.update(mEye);
+    mStreamer.upload(SCENE_UPLOAD_BUDGET);
+
+    // Keep drawing while cells are still coming in, so they show up
+    if (mStreamer.isBusy()) {
+        mScheduler.invalidate(GL::DIRTY_SCENE);
+    }
+
+    // World X goes right, world Z down the window, and the eye looks down
+    // world -Y; the view and a perspective projection in one, column major
+    const float f = 1.0f / tanf(SCENE_FOV * 0.5f);
+    const float a = -(SCENE_FAR + SCENE_NEAR) / (SCENE_FAR - SCENE_NEAR);
+    const float b = -2.0f * SCENE_FAR * SCENE_NEAR / (SCENE_FAR - SCENE_NEAR);
+    const float view[16] = {
+        f, 0.0f, 0.0f, 0.0f,
+        0.0f, 0.0f, a, -1.0f,
+        0.0f, -f, 0.0f, 0.0f,
+        -mEye[0] * f, mEye[2] * f, b - a * mEye[1], mEye[1]
+    };
+    memcpy(mSceneFrame.view, view, sizeof(view));
+    memcpy(mSceneFrame.eye, mEye, sizeof(mEye));
+    mSceneFrame.cullScale = sqrtf(f * f + 1.0f);
+
+    // Every resident instance is a draw, cell after cell
+    const std::vector<GLuint>& cells = mStreamer.residentCells();
+    mSceneFrame.firstDraw.resize(cells.size() + 1);
+    mSceneFrame.firstDraw[0] = 0;
+    for (size_t c = 0; c < cells.size(); c++) {
+        mSceneFrame.firstDraw[c + 1] = mSceneFrame.firstDraw[c] + mScene.cell(cells[c]).instanceCount;
+    }
+
+    mIndirect.beginFrame();
+    GLuint count = mIndirect.fill(mSceneFrame.firstDraw.back(), fillSceneDraws, &mSceneFrame);
+
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+    glUseProgram(sceneProgram);
+
+    if (count > 0) {
+        glBindVertexArray(mStreamer.vertexArray());
+        pointPerDrawAttributes(mIndirect.drawDataOffset(0));
+        mIndirect.submit(GL_TRIANGLES, 0, count, pointAtDraw, NULL);
+    }
+
+    mIndirect.endFrame();
+}
+
+
 void tearDown() {
 
+    mIndirect.destroy();
+    mStreamer.stop();
+    mScene.unload();
+    glDeleteProgram(sceneProgram);
+    mDebug.uninstall();
+    mUniforms.destroy();
     glDeleteProgram(program);
     glDeleteBuffers(1, &vbo);
     glDeleteVertexArrays(1, &vao);
     glfwTerminate();
 }
 
-void initWindow()
+void initWindow(bool debugContext)
 {
     // Set up OpenGL options
     // Use version 4.1
@@ -146,6 +440,9 @@ void initWindow()
 
     glfwWindowHint(GLFW_RESIZABLE, GL_FALSE);
 
+    // Debug contexts report more through KHR_debug, at some cost in speed
+    glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, debugContext ? GL_TRUE : GL_FALSE);
+
     mWindow = glfwCreateWindow(800, 600, "OpenGL", nullptr, nullptr); // windowed
     //GLFWwindow* window = glfwCreateWindow(800, 600, "OpenGL", glfwGetPrimaryMonitor(), nullptr); // fullscreen
 
@@ -159,7 +456,25 @@ void initWindow()
 }
 
 
-int main() {
+int main(int argc, char** argv) {
+
+    // Debug builds get GL debug output by default; --gl-debug and
+    // --no-gl-debug override that. Any other argument is a scene file.
+#ifdef NDEBUG
+    bool debugContext = false;
+#else
+    bool debugContext = true;
+#endif
+    const char* scenePath = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--gl-debug") == 0) {
+            debugContext = true;
+        } else if (strcmp(argv[i], "--no-gl-debug") == 0) {
+            debugContext = false;
+        } else if (strncmp(argv[i], "--", 2) != 0) {
+            scenePath = argv[i];
+        }
+    }
 
     // Initialize GLFW, and if it fails to initialize
     // for any reason, print it out to STDERR.
@@ -169,15 +484,35 @@ int main() {
         exit(EXIT_FAILURE);
     }
 
-    initWindow();
+    initWindow(debugContext);
 
     // Make the OpenGL window context active
     glfwMakeContextCurrent(mWindow);
 
     // Set the callbacks that we wired up above
     glfwSetKeyCallback(mWindow, keyPressCallback);
+    glfwSetWindowRefreshCallback(mWindow, windowRefreshCallback);
+    glfwSetFramebufferSizeCallback(mWindow, framebufferSizeCallback);
     glfwSetErrorCallback(errorCallback);
 
+    // The callback only fires on changes, so start from the size we were given
+    int framebufferWidth, framebufferHeight;
+    glfwGetFramebufferSize(mWindow, &framebufferWidth, &framebufferHeight);
+    mLodSelector.setViewportHeight((float)framebufferHeight);
+
+    // Start on vsync. If frames can't keep up, the scheduler swaps late
+    // instead of waiting out another refresh, tearing where the driver allows.
+    glfwSwapInterval(1);
+    const GLFWvidmode* mode = glfwGetVideoMode(glfwGetPrimaryMonitor());
+    bool tearing = glfwExtensionSupported("WGL_EXT_swap_control_tear") ||
+                   glfwExtensionSupported("GLX_EXT_swap_control_tear");
+
+    mScheduler.setWait(waitForEvents, NULL);
+    mScheduler.setSwapInterval(setSwapInterval, NULL);
+    mScheduler.setRefreshRate(mode ? mode->refreshRate : 60.0);
+    mScheduler.setTargetFps(TARGET_FPS);
+    mScheduler.setAdaptiveVsync(true, tearing);
+
     printf("OpenGL version supported by this platform (%s): \n", glGetString(GL_VERSION));
 
     // Force GLEW to use a modern OpenGL method for checking
@@ -187,6 +522,9 @@ int main() {
     // Make sure all extensions will be exposed in GLEW and initialize GLEW.
     glewInit();
 
+    if (debugContext) {
+        mDebug.install();
+    }
 
     GL::Shader::createProgramLinkedWithShadersVF(program, mVertex, "vertex.shader", mFragment, "fragment.shader");
 
@@ -201,6 +539,10 @@ int main() {
     glBindBuffer(GL_ARRAY_BUFFER, vbo);
     glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
 
+    GL::DebugOutput::label(GL_PROGRAM, program, "quad");
+    GL::DebugOutput::label(GL_VERTEX_ARRAY, vao, "quad");
+    GL::DebugOutput::label(GL_BUFFER, vbo, "quad vertices");
+
 
     // We can specify a Vertex Attribute pointer by is name...
     createVertexAttribPointerFromName(program, "position", GL_FLOAT, GL_FALSE, 3, sizeof(vertexPosColor), offsetof(vertexPosColor, x));
@@ -208,23 +550,74 @@ int main() {
     // ... or by its layout "location" number
     createVertexAttribPointerFromLayoutPos(1, GL_FLOAT, GL_FALSE, 3, sizeof(vertexPosColor), offsetof(vertexPosColor, r));
 
+    // Route the per-object block to its binding point, and make sure
+    // the C++ struct still matches what the shader declares
+    GL::Shader::bindUniformBlock(program, "PerObject", PER_OBJECT_BINDING);
+    GL::Shader::checkUniformBlockSize(program, "PerObject", sizeof(perObject));
+
+    // Room for a few thousand objects' worth of constants per frame
+    mUniforms.create(4096 * sizeof(perObject));
+
     glUseProgram(program);
 
+    // With a scene, start at its middle and stream cells in from there
+    bool streaming = scenePath && mScene.load(scenePath);
+    if (streaming) {
+        const GL::SceneHeader& header = mScene.header();
+        if (header.cellCount > 0) {
+            const GL::SceneCell& first = mScene.cell(0);
+            const GL::SceneCell& last = mScene.cell(header.cellCount - 1);
+            mEye[0] = (first.min[0] + last.max[0]) * 0.5f;
+            mEye[2] = (first.min[2] + last.max[2]) * 0.5f;
+        }
+
+        // High enough to see SCENE_VIEW_EXTENT of the ground either side
+        mEye[1] = SCENE_VIEW_EXTENT / tanf(SCENE_FOV * 0.5f);
+        mStreamer.start(mScene, SCENE_LOAD_RADIUS, SCENE_EVICT_RADIUS);
+
+        GL::Shader::createProgramLinkedWithShadersVF(sceneProgram, mSceneVertex, "indirect.vertex.shader", mSceneFragment, "fragment.shader");
+        GL::DebugOutput::label(GL_PROGRAM, sceneProgram, "scene");
+        mIndirect.create(SCENE_MAX_DRAWS, true, sizeof(perDraw), 3, SCENE_DRAW_WORKERS);
+    }
+
+    double angle = 0.0;
+    double lastTime = glfwGetTime();
+
     while(!glfwWindowShouldClose(mWindow)) {
 
-        glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT);
+        // Blocks until there is something new to show, and paces the
+        // frames while there is
+        if (mScheduler.waitForFrame() == GL::DIRTY_NONE) {
+            continue;
+        }
 
-        // Draw a rectangle from the 2 triangles using 6 indices
-        glDrawArrays(GL_TRIANGLES, 0, 6);
+        double time = glfwGetTime();
+        if (mScheduler.isAnimating()) {
+            angle += (time - lastTime) * SPIN_SPEED;
+        }
+        lastTime = time;
+
+        mUniforms.beginFrame();
+
+        if (streaming) {
+            drawScene();
+        } else {
+            drawQuad(angle);
+        }
+
+        mUniforms.endFrame();
 
         // Swap the back buffer and front buffer after
         // we've finished drawing
+        mScheduler.beginSwap();
         glfwSwapBuffers(mWindow);
+        mScheduler.endSwap();
 
-        glfwPollEvents();
+        // Report what the driver said about this frame
+        mDebug.endFrame();
     }
 
+    mScheduler.logStats();
     tearDown();
 
     return 0;
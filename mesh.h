@@ -0,0 +1,19 @@
+#ifndef MESH_H
+#define MESH_H
+
+// The vertex layout used by vertex.shader: position at location 0,
+// color at location 1
+struct vertexPosColor
+{
+    // Position
+    float x;
+    float y;
+    float z;
+
+    // color
+    float r;
+    float g;
+    float b;
+};
+
+#endif
@@ -0,0 +1,632 @@
+#include "meshlod.h"
+#include "debugoutput.h"
+
+#include <algorithm>
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+
+namespace GL {
+namespace Lod {
+
+    // Border edges get planes this many times stronger than surface planes,
+    // so open edges of a mesh stay where they are
+    static const double BORDER_WEIGHT = 10.0;
+
+    // A symmetric 4x4 matrix that sums squared distances to a set of planes
+    struct Quadric
+    {
+        double a00, a01, a02, a03;
+        double      a11, a12, a13;
+        double           a22, a23;
+        double                a33;
+    };
+
+    static void addPlane(Quadric& q, double a, double b, double c, double d, double weight) {
+        q.a00 += weight * a * a;  q.a01 += weight * a * b;  q.a02 += weight * a * c;  q.a03 += weight * a * d;
+        q.a11 += weight * b * b;  q.a12 += weight * b * c;  q.a13 += weight * b * d;
+        q.a22 += weight * c * c;  q.a23 += weight * c * d;
+        q.a33 += weight * d * d;
+    }
+
+    static void addQuadric(Quadric& q, const Quadric& other) {
+        q.a00 += other.a00;  q.a01 += other.a01;  q.a02 += other.a02;  q.a03 += other.a03;
+        q.a11 += other.a11;  q.a12 += other.a12;  q.a13 += other.a13;
+        q.a22 += other.a22;  q.a23 += other.a23;
+        q.a33 += other.a33;
+    }
+
+    // Weighted sum of squared distances from `v` to the planes of `q`. Every
+    // weight is at least 1, so its root bounds the distance to the farthest plane.
+    static double evaluate(const Quadric& q, const vertexPosColor& v) {
+        double x = v.x, y = v.y, z = v.z;
+        double result = q.a00 * x * x + 2.0 * q.a01 * x * y + 2.0 * q.a02 * x * z + 2.0 * q.a03 * x
+                      + q.a11 * y * y + 2.0 * q.a12 * y * z + 2.0 * q.a13 * y
+                      + q.a22 * z * z + 2.0 * q.a23 * z
+                      + q.a33;
+
+        // Rounding can push a perfect fit slightly negative
+        return result > 0.0 ? result : 0.0;
+    }
+
+    // Unnormalized normal of the triangle (a, b, c)
+    static void triangleNormal(const vertexPosColor& a, const vertexPosColor& b, const vertexPosColor& c, double n[3]) {
+        double e1[3] = { b.x - a.x, b.y - a.y, b.z - a.z };
+        double e2[3] = { c.x - a.x, c.y - a.y, c.z - a.z };
+
+        n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+        n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+        n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+    }
+
+    static bool normalize(double n[3]) {
+        double length = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        if (length == 0.0) {
+            return false;
+        }
+        n[0] /= length;
+        n[1] /= length;
+        n[2] /= length;
+        return true;
+    }
+
+
+    /**
+     * Maps every vertex to the first vertex with the same position, so that
+     * seams where only the color differs don't look like holes in the mesh.
+     */
+    static void buildPositionRemap(const std::vector<vertexPosColor>& vertices, std::vector<GLuint>& remap) {
+        std::vector<GLuint> order(vertices.size());
+        for (size_t i = 0; i < order.size(); i++) {
+            order[i] = (GLuint)i;
+        }
+
+        struct ByPosition
+        {
+            const std::vector<vertexPosColor>* v;
+            bool operator()(GLuint a, GLuint b) const {
+                const vertexPosColor& va = (*v)[a];
+                const vertexPosColor& vb = (*v)[b];
+                if (va.x != vb.x) return va.x < vb.x;
+                if (va.y != vb.y) return va.y < vb.y;
+                if (va.z != vb.z) return va.z < vb.z;
+                return a < b;
+            }
+        } byPosition = { &vertices };
+
+        std::sort(order.begin(), order.end(), byPosition);
+
+        remap.resize(vertices.size());
+        for (size_t i = 0; i < order.size(); i++) {
+            const vertexPosColor& v = vertices[order[i]];
+            const vertexPosColor* previous = i > 0 ? &vertices[order[i - 1]] : NULL;
+
+            if (previous && previous->x == v.x && previous->y == v.y && previous->z == v.z) {
+                remap[order[i]] = remap[order[i - 1]];
+            } else {
+                remap[order[i]] = order[i];
+            }
+        }
+    }
+
+
+    /**
+     * Lists the vertices sharing each welded position, so a corner can be
+     * moved to the copy at another position that keeps its own color.
+     */
+    static void buildPositionGroups(const std::vector<GLuint>& remap, std::vector<GLuint>& offsets, std::vector<GLuint>& group) {
+        offsets.assign(remap.size() + 1, 0);
+        for (size_t v = 0; v < remap.size(); v++) {
+            offsets[remap[v] + 1]++;
+        }
+        for (size_t v = 0; v < remap.size(); v++) {
+            offsets[v + 1] += offsets[v];
+        }
+
+        group.resize(remap.size());
+        std::vector<GLuint> fill(offsets.begin(), offsets.end() - 1);
+        for (size_t v = 0; v < remap.size(); v++) {
+            group[fill[remap[v]]++] = (GLuint)v;
+        }
+    }
+
+    static float colorDistance(const vertexPosColor& a, const vertexPosColor& b) {
+        float dr = a.r - b.r, dg = a.g - b.g, db = a.b - b.b;
+        return dr * dr + dg * dg + db * db;
+    }
+
+    // The vertex at welded position `target` whose color is closest to `corner`'s
+    static GLuint matchCorner(const std::vector<vertexPosColor>& vertices, const std::vector<GLuint>& offsets,
+                              const std::vector<GLuint>& group, GLuint corner, GLuint target) {
+        GLuint best = target;
+        float bestDistance = FLT_MAX;
+
+        for (GLuint i = offsets[target]; i < offsets[target + 1]; i++) {
+            float distance = colorDistance(vertices[corner], vertices[group[i]]);
+            if (distance < bestDistance) {
+                best = group[i];
+                bestDistance = distance;
+            }
+        }
+        return best;
+    }
+
+
+    struct Edge
+    {
+        GLuint  a, b;       // a < b
+        GLuint  triangle;   // A triangle using the edge
+        GLuint  count;      // Number of triangles using the edge
+    };
+
+    static bool edgeLess(const Edge& x, const Edge& y) {
+        return x.a != y.a ? x.a < y.a : x.b < y.b;
+    }
+
+    // Lists every distinct edge of a triangle list along with how often it is used
+    static void collectEdges(const std::vector<GLuint>& triangles, std::vector<Edge>& edges) {
+        std::vector<Edge> all;
+        all.reserve(triangles.size());
+
+        for (size_t t = 0; t < triangles.size(); t += 3) {
+            for (int k = 0; k < 3; k++) {
+                GLuint u = triangles[t + k];
+                GLuint v = triangles[t + (k + 1) % 3];
+                Edge e = { std::min(u, v), std::max(u, v), (GLuint)(t / 3), 1 };
+                all.push_back(e);
+            }
+        }
+
+        std::sort(all.begin(), all.end(), edgeLess);
+
+        edges.clear();
+        for (size_t i = 0; i < all.size(); i++) {
+            if (!edges.empty() && edges.back().a == all[i].a && edges.back().b == all[i].b) {
+                edges.back().count++;
+            } else {
+                edges.push_back(all[i]);
+            }
+        }
+    }
+
+
+    struct Collapse
+    {
+        GLuint  from;
+        GLuint  to;
+        double  cost;
+    };
+
+    static bool collapseLess(const Collapse& x, const Collapse& y) {
+        return x.cost < y.cost;
+    }
+
+
+    std::vector<GLuint> simplify(
+        const std::vector<vertexPosColor>& vertices,
+        const std::vector<GLuint>& indices,
+        size_t targetIndexCount,
+        float maxError,
+        float* resultError) {
+        size_t vertexCount = vertices.size();
+
+        std::vector<GLuint> remap;
+        buildPositionRemap(vertices, remap);
+
+        std::vector<GLuint> groupOffsets, group;
+        buildPositionGroups(remap, groupOffsets, group);
+
+        // Positions whose copies differ in color lie on a seam
+        std::vector<bool> seam(vertexCount, false);
+        for (size_t v = 0; v < vertexCount; v++) {
+            if (colorDistance(vertices[v], vertices[remap[v]]) > 0.0f) {
+                seam[remap[v]] = true;
+            }
+        }
+
+        // Topology works on position-welded vertices; `corners` remembers
+        // which actual vertex each corner used, so colors survive
+        std::vector<GLuint> triangles;
+        std::vector<GLuint> corners;
+        triangles.reserve(indices.size());
+        corners.reserve(indices.size());
+
+        for (size_t t = 0; t + 2 < indices.size(); t += 3) {
+            GLuint a = remap[indices[t]], b = remap[indices[t + 1]], c = remap[indices[t + 2]];
+            if (a != b && b != c && c != a) {
+                triangles.push_back(a);
+                triangles.push_back(b);
+                triangles.push_back(c);
+                corners.push_back(indices[t]);
+                corners.push_back(indices[t + 1]);
+                corners.push_back(indices[t + 2]);
+            }
+        }
+
+        Quadric zero = { 0 };
+        std::vector<Quadric> quadrics(vertexCount, zero);
+
+        for (size_t t = 0; t < triangles.size(); t += 3) {
+            const vertexPosColor& p0 = vertices[triangles[t]];
+            double n[3];
+            triangleNormal(p0, vertices[triangles[t + 1]], vertices[triangles[t + 2]], n);
+
+            if (!normalize(n)) {
+                continue;
+            }
+            double d = -(n[0] * p0.x + n[1] * p0.y + n[2] * p0.z);
+
+            for (int k = 0; k < 3; k++) {
+                addPlane(quadrics[triangles[t + k]], n[0], n[1], n[2], d, 1.0);
+            }
+        }
+
+        // Pin open borders with planes standing perpendicular to the surface
+        std::vector<Edge> edges;
+        std::vector<bool> border(vertexCount, false);
+        collectEdges(triangles, edges);
+
+        for (size_t i = 0; i < edges.size(); i++) {
+            const Edge& e = edges[i];
+            if (e.count != 1) {
+                continue;
+            }
+            border[e.a] = border[e.b] = true;
+
+            size_t t = e.triangle * 3;
+            double n[3];
+            triangleNormal(vertices[triangles[t]], vertices[triangles[t + 1]], vertices[triangles[t + 2]], n);
+
+            const vertexPosColor& pa = vertices[e.a];
+            const vertexPosColor& pb = vertices[e.b];
+            double along[3] = { pb.x - pa.x, pb.y - pa.y, pb.z - pa.z };
+            double p[3] = {
+                along[1] * n[2] - along[2] * n[1],
+                along[2] * n[0] - along[0] * n[2],
+                along[0] * n[1] - along[1] * n[0]
+            };
+
+            if (normalize(p)) {
+                double d = -(p[0] * pa.x + p[1] * pa.y + p[2] * pa.z);
+                addPlane(quadrics[e.a], p[0], p[1], p[2], d, BORDER_WEIGHT);
+                addPlane(quadrics[e.b], p[0], p[1], p[2], d, BORDER_WEIGHT);
+            }
+        }
+
+        double maxCost = (double)maxError * maxError;
+        double error = 0.0;
+
+        std::vector<Collapse> candidates;
+        std::vector<GLuint> adjacencyOffsets(vertexCount + 1);
+        std::vector<GLuint> adjacency;
+        std::vector<GLuint> collapsedTo(vertexCount);
+        std::vector<char> locked(vertexCount);
+        std::vector<char> marked(vertexCount, 0);
+
+        // Each pass collapses the cheapest edges it can without two collapses
+        // touching the same triangles, then rebuilds the edge list
+        while (triangles.size() > targetIndexCount) {
+            collectEdges(triangles, edges);
+
+            // Triangles around each vertex
+            std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+            for (size_t i = 0; i < triangles.size(); i++) {
+                adjacencyOffsets[triangles[i] + 1]++;
+            }
+            for (size_t v = 0; v < vertexCount; v++) {
+                adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+            }
+            adjacency.resize(triangles.size());
+            std::vector<GLuint> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+            for (size_t i = 0; i < triangles.size(); i++) {
+                adjacency[fill[triangles[i]]++] = (GLuint)(i / 3);
+            }
+
+            candidates.clear();
+            for (size_t i = 0; i < edges.size(); i++) {
+                const Edge& e = edges[i];
+                bool borderEdge = e.count == 1;
+
+                // Border vertices may only slide along the border, and seam
+                // vertices only onto other seam vertices, so neither side of
+                // a seam takes on the other's color
+                bool aToB = (!border[e.a] || borderEdge) && (!seam[e.a] || seam[e.b]);
+                bool bToA = (!border[e.b] || borderEdge) && (!seam[e.b] || seam[e.a]);
+                if (!aToB && !bToA) {
+                    continue;
+                }
+
+                Quadric q = quadrics[e.a];
+                addQuadric(q, quadrics[e.b]);
+
+                double costAToB = aToB ? evaluate(q, vertices[e.b]) : DBL_MAX;
+                double costBToA = bToA ? evaluate(q, vertices[e.a]) : DBL_MAX;
+
+                Collapse c;
+                if (costAToB <= costBToA) {
+                    c.from = e.a; c.to = e.b; c.cost = costAToB;
+                } else {
+                    c.from = e.b; c.to = e.a; c.cost = costBToA;
+                }
+                candidates.push_back(c);
+            }
+
+            std::sort(candidates.begin(), candidates.end(), collapseLess);
+
+            for (size_t v = 0; v < vertexCount; v++) {
+                collapsedTo[v] = (GLuint)v;
+            }
+            std::fill(locked.begin(), locked.end(), 0);
+
+            size_t trianglesToRemove = (triangles.size() - targetIndexCount + 2) / 3;
+            size_t removed = 0;
+            size_t collapses = 0;
+
+            for (size_t i = 0; i < candidates.size() && removed < trianglesToRemove; i++) {
+                const Collapse& c = candidates[i];
+                if (c.cost > maxCost) {
+                    break;
+                }
+                if (locked[c.from] || locked[c.to]) {
+                    continue;
+                }
+
+                GLuint begin = adjacencyOffsets[c.from], end = adjacencyOffsets[c.from + 1];
+
+                // Reject collapses that would flip a triangle over, and ones that
+                // would glue the surface to itself (more shared neighbours than
+                // shared triangles)
+                bool valid = true;
+                size_t shared = 0;
+
+                for (GLuint j = begin; j < end && valid; j++) {
+                    size_t t = adjacency[j] * 3;
+                    GLuint tri[3] = { triangles[t], triangles[t + 1], triangles[t + 2] };
+
+                    if (tri[0] == c.to || tri[1] == c.to || tri[2] == c.to) {
+                        shared++;
+                        continue;
+                    }
+
+                    double before[3], after[3];
+                    triangleNormal(vertices[tri[0]], vertices[tri[1]], vertices[tri[2]], before);
+                    for (int k = 0; k < 3; k++) {
+                        if (tri[k] == c.from) {
+                            tri[k] = c.to;
+                        }
+                    }
+                    triangleNormal(vertices[tri[0]], vertices[tri[1]], vertices[tri[2]], after);
+
+                    valid = before[0] * after[0] + before[1] * after[1] + before[2] * after[2] > 0.0;
+                }
+
+                if (valid) {
+                    for (GLuint j = begin; j < end; j++) {
+                        size_t t = adjacency[j] * 3;
+                        for (int k = 0; k < 3; k++) {
+                            marked[triangles[t + k]] = 1;
+                        }
+                    }
+
+                    size_t common = 0;
+                    for (GLuint j = adjacencyOffsets[c.to]; j < adjacencyOffsets[c.to + 1]; j++) {
+                        size_t t = adjacency[j] * 3;
+                        for (int k = 0; k < 3; k++) {
+                            GLuint v = triangles[t + k];
+                            if (marked[v] == 1 && v != c.from && v != c.to) {
+                                marked[v] = 2;
+                                common++;
+                            }
+                        }
+                    }
+
+                    for (GLuint j = begin; j < end; j++) {
+                        size_t t = adjacency[j] * 3;
+                        for (int k = 0; k < 3; k++) {
+                            marked[triangles[t + k]] = 0;
+                        }
+                    }
+
+                    valid = common <= shared;
+                }
+
+                if (!valid) {
+                    continue;
+                }
+
+                collapsedTo[c.from] = c.to;
+                addQuadric(quadrics[c.to], quadrics[c.from]);
+
+                // Everything around `from` changes shape, so leave it for the next pass
+                for (GLuint j = begin; j < end; j++) {
+                    size_t t = adjacency[j] * 3;
+                    locked[triangles[t]] = locked[triangles[t + 1]] = locked[triangles[t + 2]] = 1;
+                }
+
+                error = std::max(error, sqrt(c.cost));
+                removed += shared;
+                collapses++;
+            }
+
+            if (collapses == 0) {
+                break;
+            }
+
+            // Apply the collapses and drop triangles that became degenerate
+            size_t write = 0;
+            for (size_t t = 0; t < triangles.size(); t += 3) {
+                for (int k = 0; k < 3; k++) {
+                    GLuint v = triangles[t + k];
+                    if (collapsedTo[v] != v) {
+                        triangles[t + k] = collapsedTo[v];
+                        corners[t + k] = matchCorner(vertices, groupOffsets, group, corners[t + k], collapsedTo[v]);
+                    }
+                }
+
+                GLuint a = triangles[t], b = triangles[t + 1], c = triangles[t + 2];
+                if (a != b && b != c && c != a) {
+                    for (int k = 0; k < 3; k++) {
+                        triangles[write + k] = triangles[t + k];
+                        corners[write + k] = corners[t + k];
+                    }
+                    write += 3;
+                }
+            }
+            triangles.resize(write);
+            corners.resize(write);
+        }
+
+        if (resultError) {
+            *resultError = (float)error;
+        }
+
+        return corners;
+    }
+
+
+    void generate(
+        const std::vector<vertexPosColor>& vertices,
+        const std::vector<GLuint>& indices,
+        int levelCount,
+        float ratio,
+        std::vector<GLuint>& lodIndices,
+        std::vector<Level>& levels) {
+        lodIndices.assign(indices.begin(), indices.end());
+        levels.clear();
+
+        Level base = { 0, (GLsizei)indices.size(), 0.0f };
+        levels.push_back(base);
+
+        // Each level is simplified from the one before, so its error adds up
+        std::vector<GLuint> current = indices;
+        float error = 0.0f;
+
+        for (int l = 1; l < levelCount; l++) {
+            size_t target = (size_t)(current.size() / 3 * ratio) * 3;
+            float levelError = 0.0f;
+            std::vector<GLuint> next = simplify(vertices, current, target, FLT_MAX, &levelError);
+
+            if (next.empty() || next.size() >= current.size()) {
+                break;
+            }
+
+            error += levelError;
+            Level level = { (GLuint)lodIndices.size(), (GLsizei)next.size(), error };
+            levels.push_back(level);
+
+            lodIndices.insert(lodIndices.end(), next.begin(), next.end());
+            current.swap(next);
+        }
+    }
+
+
+    void bounds(const std::vector<vertexPosColor>& vertices, float center[3], float& radius) {
+        float lo[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+        float hi[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+        for (size_t i = 0; i < vertices.size(); i++) {
+            const float p[3] = { vertices[i].x, vertices[i].y, vertices[i].z };
+            for (int k = 0; k < 3; k++) {
+                lo[k] = std::min(lo[k], p[k]);
+                hi[k] = std::max(hi[k], p[k]);
+            }
+        }
+
+        radius = 0.0f;
+        for (int k = 0; k < 3; k++) {
+            center[k] = vertices.empty() ? 0.0f : (lo[k] + hi[k]) * 0.5f;
+        }
+
+        for (size_t i = 0; i < vertices.size(); i++) {
+            float dx = vertices[i].x - center[0];
+            float dy = vertices[i].y - center[1];
+            float dz = vertices[i].z - center[2];
+            radius = std::max(radius, sqrtf(dx * dx + dy * dy + dz * dz));
+        }
+    }
+
+
+    void createMesh(Mesh& mesh, const std::vector<vertexPosColor>& vertices,
+                    const std::vector<GLuint>& indices, int levelCount, float ratio) {
+        std::vector<GLuint> lodIndices;
+        generate(vertices, indices, levelCount, ratio, lodIndices, mesh.levels);
+        bounds(vertices, mesh.center, mesh.radius);
+
+        for (size_t l = 0; l < mesh.levels.size(); l++) {
+            printf("LOD %i: %i triangles, error: %f\n",
+                   (int)l, mesh.levels[l].indexCount / 3, mesh.levels[l].error);
+        }
+
+        glGenVertexArrays(1, &mesh.vao);
+        glBindVertexArray(mesh.vao);
+
+        glGenBuffers(1, &mesh.vbo);
+        glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(vertexPosColor), vertices.empty() ? NULL : &vertices[0], GL_STATIC_DRAW);
+
+        glGenBuffers(1, &mesh.ibo);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.ibo);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, lodIndices.size() * sizeof(GLuint), lodIndices.empty() ? NULL : &lodIndices[0], GL_STATIC_DRAW);
+
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(vertexPosColor), (void*)offsetof(vertexPosColor, x));
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(vertexPosColor), (void*)offsetof(vertexPosColor, r));
+        glEnableVertexAttribArray(1);
+
+        DebugOutput::label(GL_VERTEX_ARRAY, mesh.vao, "LOD mesh");
+        DebugOutput::label(GL_BUFFER, mesh.vbo, "LOD mesh vertices");
+        DebugOutput::label(GL_BUFFER, mesh.ibo, "LOD mesh indices");
+    }
+
+    void destroyMesh(Mesh& mesh) {
+        glDeleteBuffers(1, &mesh.ibo);
+        glDeleteBuffers(1, &mesh.vbo);
+        glDeleteVertexArrays(1, &mesh.vao);
+        mesh.levels.clear();
+    }
+
+    void draw(const Mesh& mesh, int level) {
+        const Level& l = mesh.levels[level];
+        glDrawElements(GL_TRIANGLES, l.indexCount, GL_UNSIGNED_INT, (void*)(size_t)(l.firstIndex * sizeof(GLuint)));
+    }
+
+
+    Selector::Selector(float fovY, float viewportHeight, float threshold)
+        : _viewExtent(2.0f * tanf(fovY * 0.5f)), _pixelsPerUnit(viewportHeight / _viewExtent), _threshold(threshold) {}
+
+    void Selector::setViewportHeight(float viewportHeight) {
+        _pixelsPerUnit = viewportHeight / _viewExtent;
+    }
+
+    float Selector::projectedSize(float objectSize, float distance) const {
+        return objectSize * _pixelsPerUnit / std::max(distance, 1e-6f);
+    }
+
+    int Selector::select(const Mesh& mesh, float distance) const {
+        return mesh.levels.empty() ? 0 : select(&mesh.levels[0], (int)mesh.levels.size(), distance);
+    }
+
+    int Selector::select(const Level* levels, int levelCount, float distance) const {
+        for (int l = levelCount - 1; l > 0; l--) {
+            if (projectedSize(levels[l].error, distance) <= _threshold) {
+                return l;
+            }
+        }
+        return 0;
+    }
+
+    void Selector::select(const Mesh& mesh, const float* positions, size_t count,
+                          const float eye[3], int* levels) const {
+        for (size_t i = 0; i < count; i++) {
+            const float* p = positions + i * 3;
+            float dx = p[0] + mesh.center[0] - eye[0];
+            float dy = p[1] + mesh.center[1] - eye[1];
+            float dz = p[2] + mesh.center[2] - eye[2];
+
+            // Measure from the nearest point of the bounding sphere
+            float distance = sqrtf(dx * dx + dy * dy + dz * dz) - mesh.radius;
+            levels[i] = select(mesh, distance);
+        }
+    }
+}
+}
@@ -0,0 +1,107 @@
+#ifndef MESHLOD_H
+#define MESHLOD_H
+
+#include <GL/glew.h>
+#include <vector>
+#include "mesh.h"
+
+namespace GL {
+namespace Lod {
+
+    // One level of detail: a range of the mesh's shared index buffer
+    struct Level
+    {
+        GLuint  firstIndex;
+        GLsizei indexCount;
+        float   error;      // Upper bound on the deviation from level 0, in object units
+    };
+
+    /**
+     * Simplifies an indexed triangle mesh with quadric error metric edge
+     * collapses, until it has at most `targetIndexCount` indices or the
+     * next collapse would move the surface by more than `maxError`.
+     *
+     * Collapses move a vertex onto one of its neighbours rather than to a
+     * new position, so the result indexes into the original vertex array and
+     * every level can share a single vertex buffer. Vertices that share a
+     * position (e.g. along color seams) are collapsed together, but each
+     * corner keeps the copy with its own color. Seams and open borders are
+     * preserved.
+     *
+     * Returns the new index list; `resultError` receives the error reached.
+     */
+    std::vector<GLuint> simplify(
+        const std::vector<vertexPosColor>& vertices,
+        const std::vector<GLuint>& indices,
+        size_t targetIndexCount,
+        float maxError,
+        float* resultError = NULL
+    );
+
+    // Builds `levelCount` levels, each with about `ratio` times the triangles of
+    // the one before. Level 0 is the original mesh. The indices of every level
+    // are appended to `lodIndices`. Stops early once a level can't be reduced.
+    void generate(
+        const std::vector<vertexPosColor>& vertices,
+        const std::vector<GLuint>& indices,
+        int levelCount,
+        float ratio,
+        std::vector<GLuint>& lodIndices,
+        std::vector<Level>& levels
+    );
+
+    // Computes a bounding sphere that encloses every vertex
+    void bounds(const std::vector<vertexPosColor>& vertices, float center[3], float& radius);
+
+
+    // A mesh uploaded with all of its levels of detail
+    struct Mesh
+    {
+        GLuint              vao;
+        GLuint              vbo;
+        GLuint              ibo;
+        std::vector<Level>  levels;
+        float               center[3];  // Bounding sphere, in object space
+        float               radius;
+    };
+
+    // Generates the levels and uploads them, with the attribute layout of main.cpp
+    void createMesh(Mesh& mesh, const std::vector<vertexPosColor>& vertices,
+                    const std::vector<GLuint>& indices, int levelCount, float ratio = 0.5f);
+    void destroyMesh(Mesh& mesh);
+
+    // Draws one level. The mesh's VAO must be bound.
+    void draw(const Mesh& mesh, int level);
+
+
+    /**
+     * Picks a level per instance from its size on screen: the coarsest level
+     * whose error, projected at the instance's distance, stays under
+     * `threshold` pixels.
+     */
+    class Selector {
+    public:
+        // `fovY` is the vertical field of view in radians
+        Selector(float fovY, float viewportHeight, float threshold = 1.0f);
+
+        void setViewportHeight(float viewportHeight); // Call when the framebuffer is resized.
+
+        // Size in pixels of `objectSize` units seen from `distance` away
+        float projectedSize(float objectSize, float distance) const;
+
+        int select(const Mesh& mesh, float distance) const;
+        int select(const Level* levels, int levelCount, float distance) const;
+
+        // Selects a level for each of `count` instance positions (xyz) as seen from `eye`
+        void select(const Mesh& mesh, const float* positions, size_t count,
+                    const float eye[3], int* levels) const;
+
+    private:
+        float _viewExtent;      // Units covered by the viewport's height at distance 1
+        float _pixelsPerUnit;   // Pixels covered by one unit at distance 1
+        float _threshold;
+    };
+}
+}
+
+#endif
@@ -0,0 +1,435 @@
+#include "rendergraph.h"
+#include "debugoutput.h"
+
+#include <stdio.h>
+
+namespace GL {
+
+    // Pooled textures and framebuffers unused for this many frames are deleted
+    static const unsigned int MAX_IDLE_FRAMES = 3;
+
+    static bool isDepthFormat(GLenum format) {
+        switch (format) {
+            case GL_DEPTH_COMPONENT16:
+            case GL_DEPTH_COMPONENT24:
+            case GL_DEPTH_COMPONENT32:
+            case GL_DEPTH_COMPONENT32F:
+            case GL_DEPTH24_STENCIL8:
+            case GL_DEPTH32F_STENCIL8:
+                return true;
+        }
+        return false;
+    }
+
+    static GLenum attachmentPoint(GLenum format) {
+        if (format == GL_DEPTH24_STENCIL8 || format == GL_DEPTH32F_STENCIL8) {
+            return GL_DEPTH_STENCIL_ATTACHMENT;
+        }
+        return GL_DEPTH_ATTACHMENT;
+    }
+
+    static GLsizeiptr bytesPerPixel(GLenum format) {
+        switch (format) {
+            case GL_R8:                 return 1;
+            case GL_RG8:
+            case GL_R16F:
+            case GL_DEPTH_COMPONENT16:  return 2;
+            case GL_RGBA16F:
+            case GL_RG32F:
+            case GL_DEPTH32F_STENCIL8:  return 8;
+            case GL_RGBA32F:            return 16;
+        }
+        // RGBA8, RGB10_A2, R11F_G11F_B10F, RG16F, R32F and 24/32-bit depth
+        return 4;
+    }
+
+    static GLsizeiptr textureBytes(const TextureDesc& desc) {
+        return (GLsizeiptr)desc.width * desc.height * bytesPerPixel(desc.internalFormat);
+    }
+
+    static bool sameDesc(const TextureDesc& a, const TextureDesc& b) {
+        return a.width == b.width && a.height == b.height && a.internalFormat == b.internalFormat;
+    }
+
+
+    // Public
+
+    RenderGraph::RenderGraph() : _frame(0), _culled(0), _canInvalidate(false) {}
+
+    RenderGraph::~RenderGraph() {}
+
+    void RenderGraph::reset() {
+        _resources.clear();
+        _passes.clear();
+        _culled = 0;
+    }
+
+    void RenderGraph::destroy() {
+        for (size_t i = 0; i < _pool.size(); i++) {
+            glDeleteTextures(1, &_pool[i].texture);
+        }
+        for (size_t i = 0; i < _framebuffers.size(); i++) {
+            glDeleteFramebuffers(1, &_framebuffers[i].fbo);
+        }
+        _pool.clear();
+        _framebuffers.clear();
+        reset();
+    }
+
+    int RenderGraph::createTexture(const char* name, const TextureDesc& desc) {
+        Resource resource;
+        resource.name = name;
+        resource.desc = desc;
+        resource.imported = 0;
+        resource.first = -1;
+        resource.last = -1;
+        resource.physical = -1;
+
+        _resources.push_back(resource);
+        return (int)_resources.size() - 1;
+    }
+
+    int RenderGraph::importTexture(const char* name, GLuint texture, const TextureDesc& desc) {
+        int id = createTexture(name, desc);
+        _resources[id].imported = texture;
+        return id;
+    }
+
+    int RenderGraph::addPass(const char* name, PassFn fn, void* userData) {
+        Pass pass;
+        pass.name = name;
+        pass.fn = fn;
+        pass.userData = userData;
+        pass.backbuffer = false;
+        pass.backbufferWidth = 0;
+        pass.backbufferHeight = 0;
+        pass.culled = false;
+
+        _passes.push_back(pass);
+        return (int)_passes.size() - 1;
+    }
+
+    void RenderGraph::writes(int pass, int resource) {
+        _passes[pass].writes.push_back(resource);
+    }
+
+    void RenderGraph::reads(int pass, int resource) {
+        _passes[pass].reads.push_back(resource);
+    }
+
+    void RenderGraph::writesBackbuffer(int pass, GLsizei width, GLsizei height) {
+        _passes[pass].backbuffer = true;
+        _passes[pass].backbufferWidth = width;
+        _passes[pass].backbufferHeight = height;
+    }
+
+
+    /**
+     * Passes only ever depend on passes declared before them, so a single
+     * walk backwards from the passes with visible results finds everything
+     * that's needed. Transients are then handed out in pass order: each one
+     * takes a free pooled texture of the same description when its first pass
+     * starts, and gives it back after its last pass.
+     */
+    void RenderGraph::compile() {
+        _frame++;
+        _canInvalidate = GLEW_VERSION_4_3 || GLEW_ARB_invalidate_subdata;
+
+        std::vector<bool> needed(_resources.size(), false);
+        _culled = 0;
+
+        for (int p = (int)_passes.size() - 1; p >= 0; p--) {
+            Pass& pass = _passes[p];
+            bool visible = pass.backbuffer;
+
+            for (size_t i = 0; i < pass.writes.size() && !visible; i++) {
+                int r = pass.writes[i];
+                visible = needed[r] || _resources[r].imported != 0;
+            }
+
+            pass.culled = !visible;
+            if (pass.culled) {
+                _culled++;
+                continue;
+            }
+
+            for (size_t i = 0; i < pass.reads.size(); i++) {
+                needed[pass.reads[i]] = true;
+            }
+        }
+
+        // Lifetimes, over the passes that will actually run
+        for (size_t r = 0; r < _resources.size(); r++) {
+            _resources[r].first = -1;
+            _resources[r].last = -1;
+            _resources[r].physical = -1;
+        }
+        for (int p = 0; p < (int)_passes.size(); p++) {
+            const Pass& pass = _passes[p];
+            if (pass.culled) {
+                continue;
+            }
+            for (int rw = 0; rw < 2; rw++) {
+                const std::vector<int>& used = rw == 0 ? pass.writes : pass.reads;
+                for (size_t i = 0; i < used.size(); i++) {
+                    Resource& resource = _resources[used[i]];
+                    if (resource.first == -1) {
+                        resource.first = p;
+                    }
+                    resource.last = p;
+                }
+            }
+        }
+
+        // Hand out pooled textures
+        for (size_t i = 0; i < _pool.size(); i++) {
+            _pool[i].inUse = false;
+        }
+        for (int p = 0; p < (int)_passes.size(); p++) {
+            for (size_t r = 0; r < _resources.size(); r++) {
+                Resource& resource = _resources[r];
+                if (resource.first == p && !resource.imported) {
+                    resource.physical = acquire(resource.desc, resource.name.c_str());
+                }
+            }
+            for (size_t r = 0; r < _resources.size(); r++) {
+                Resource& resource = _resources[r];
+                if (resource.last == p && resource.physical != -1) {
+                    _pool[resource.physical].inUse = false;
+                }
+            }
+        }
+
+        trim();
+    }
+
+
+    void RenderGraph::execute() {
+        for (int p = 0; p < (int)_passes.size(); p++) {
+            const Pass& pass = _passes[p];
+            if (pass.culled) {
+                continue;
+            }
+
+            if (pass.backbuffer) {
+                // An earlier offscreen pass may have left a smaller viewport behind
+                glBindFramebuffer(GL_FRAMEBUFFER, 0);
+                glViewport(0, 0, pass.backbufferWidth, pass.backbufferHeight);
+            } else {
+                glBindFramebuffer(GL_FRAMEBUFFER, framebufferFor(pass));
+
+                // Every attachment shares the size of the first one
+                if (!pass.writes.empty()) {
+                    const TextureDesc& desc = _resources[pass.writes[0]].desc;
+                    glViewport(0, 0, desc.width, desc.height);
+                }
+
+                // Whatever an aliased texture held before is garbage to this pass
+                invalidate(pass, p, true);
+            }
+
+            pass.fn(*this, pass.userData);
+
+            if (!pass.backbuffer) {
+                invalidate(pass, p, false);
+            }
+        }
+
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+
+    GLuint RenderGraph::getTexture(int resource) {
+        const Resource& r = _resources[resource];
+        if (r.imported) {
+            return r.imported;
+        }
+        return r.physical != -1 ? _pool[r.physical].texture : 0;
+    }
+
+    GLsizeiptr RenderGraph::transientBytes() {
+        GLsizeiptr bytes = 0;
+        for (size_t r = 0; r < _resources.size(); r++) {
+            if (!_resources[r].imported && _resources[r].first != -1) {
+                bytes += textureBytes(_resources[r].desc);
+            }
+        }
+        return bytes;
+    }
+
+    GLsizeiptr RenderGraph::pooledBytes() {
+        GLsizeiptr bytes = 0;
+        for (size_t i = 0; i < _pool.size(); i++) {
+            bytes += textureBytes(_pool[i].desc);
+        }
+        return bytes;
+    }
+
+    int RenderGraph::passesCulled() {
+        return _culled;
+    }
+
+    // END Public
+
+
+    // Private
+
+    int RenderGraph::acquire(const TextureDesc& desc, const char* name) {
+        for (size_t i = 0; i < _pool.size(); i++) {
+            PhysicalTexture& physical = _pool[i];
+            if (!physical.inUse && sameDesc(physical.desc, desc)) {
+                physical.inUse = true;
+                physical.lastFrame = _frame;
+                return (int)i;
+            }
+        }
+
+        PhysicalTexture physical;
+        physical.desc = desc;
+        physical.inUse = true;
+        physical.lastFrame = _frame;
+
+        glGenTextures(1, &physical.texture);
+        glBindTexture(GL_TEXTURE_2D, physical.texture);
+        glTexStorage2D(GL_TEXTURE_2D, 1, desc.internalFormat, desc.width, desc.height);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+        // Named after the first resource placed in it; later ones may alias it
+        DebugOutput::label(GL_TEXTURE, physical.texture, name);
+
+        printf("Creating render target: %ix%i format: 0x%04x ID: %i\n",
+               desc.width, desc.height, desc.internalFormat, physical.texture);
+
+        _pool.push_back(physical);
+        return (int)_pool.size() - 1;
+    }
+
+
+    /**
+     * Framebuffers are cached by their exact list of attachments, so a
+     * steady frame re-binds the same objects instead of re-attaching.
+     */
+    GLuint RenderGraph::framebufferFor(const Pass& pass) {
+        std::vector<GLuint> attachments;
+        for (size_t i = 0; i < pass.writes.size(); i++) {
+            attachments.push_back(getTexture(pass.writes[i]));
+        }
+
+        for (size_t i = 0; i < _framebuffers.size(); i++) {
+            if (_framebuffers[i].attachments == attachments) {
+                _framebuffers[i].lastFrame = _frame;
+                return _framebuffers[i].fbo;
+            }
+        }
+
+        Framebuffer framebuffer;
+        framebuffer.attachments = attachments;
+        framebuffer.lastFrame = _frame;
+        glGenFramebuffers(1, &framebuffer.fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer.fbo);
+
+        std::vector<GLenum> drawBuffers;
+        for (size_t i = 0; i < pass.writes.size(); i++) {
+            GLenum format = _resources[pass.writes[i]].desc.internalFormat;
+            GLenum attachment;
+
+            if (isDepthFormat(format)) {
+                attachment = attachmentPoint(format);
+            } else {
+                attachment = GL_COLOR_ATTACHMENT0 + (GLenum)drawBuffers.size();
+                drawBuffers.push_back(attachment);
+            }
+            glFramebufferTexture(GL_FRAMEBUFFER, attachment, attachments[i], 0);
+        }
+
+        if (drawBuffers.empty()) {
+            glDrawBuffer(GL_NONE);
+        } else {
+            glDrawBuffers((GLsizei)drawBuffers.size(), &drawBuffers[0]);
+        }
+        DebugOutput::label(GL_FRAMEBUFFER, framebuffer.fbo, pass.name.c_str());
+
+        GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+        if (status != GL_FRAMEBUFFER_COMPLETE) {
+            fprintf(stderr, "Render pass %s has an incomplete framebuffer: 0x%04x\n",
+                    pass.name.c_str(), status);
+        }
+
+        _framebuffers.push_back(framebuffer);
+        return framebuffer.fbo;
+    }
+
+
+    /**
+     * When `starting`, invalidates the transients this pass is the first to
+     * touch; otherwise the ones it is the last to touch, which nobody will
+     * read again.
+     */
+    void RenderGraph::invalidate(const Pass& pass, int passIndex, bool starting) {
+        if (!_canInvalidate) {
+            return;
+        }
+
+        GLenum attachments[16];
+        GLsizei count = 0;
+        GLenum nextColor = GL_COLOR_ATTACHMENT0;
+
+        for (size_t i = 0; i < pass.writes.size() && count < 16; i++) {
+            const Resource& resource = _resources[pass.writes[i]];
+            GLenum format = resource.desc.internalFormat;
+            GLenum attachment = isDepthFormat(format) ? attachmentPoint(format) : nextColor++;
+
+            int boundary = starting ? resource.first : resource.last;
+            if (!resource.imported && boundary == passIndex) {
+                attachments[count++] = attachment;
+            }
+        }
+
+        if (count > 0) {
+            glInvalidateFramebuffer(GL_FRAMEBUFFER, count, attachments);
+        }
+    }
+
+
+    void RenderGraph::trim() {
+        for (size_t i = 0; i < _framebuffers.size(); ) {
+            if (_frame - _framebuffers[i].lastFrame > MAX_IDLE_FRAMES) {
+                glDeleteFramebuffers(1, &_framebuffers[i].fbo);
+                _framebuffers.erase(_framebuffers.begin() + i);
+            } else {
+                i++;
+            }
+        }
+
+        // Deleting from the pool shifts indices, so remap this frame's resources
+        for (size_t i = _pool.size(); i-- > 0; ) {
+            if (_frame - _pool[i].lastFrame > MAX_IDLE_FRAMES) {
+                // Texture names get recycled, so drop framebuffers that used it
+                for (size_t f = _framebuffers.size(); f-- > 0; ) {
+                    const std::vector<GLuint>& attachments = _framebuffers[f].attachments;
+                    for (size_t a = 0; a < attachments.size(); a++) {
+                        if (attachments[a] == _pool[i].texture) {
+                            glDeleteFramebuffers(1, &_framebuffers[f].fbo);
+                            _framebuffers.erase(_framebuffers.begin() + f);
+                            break;
+                        }
+                    }
+                }
+
+                glDeleteTextures(1, &_pool[i].texture);
+                _pool.erase(_pool.begin() + i);
+
+                for (size_t r = 0; r < _resources.size(); r++) {
+                    if (_resources[r].physical > (int)i) {
+                        _resources[r].physical--;
+                    }
+                }
+            }
+        }
+    }
+
+    // END Private
+}
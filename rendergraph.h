@@ -0,0 +1,137 @@
+#ifndef RENDERGRAPH_H
+#define RENDERGRAPH_H
+
+#include <GL/glew.h>
+#include <string>
+#include <vector>
+
+namespace GL {
+
+    // Describes a render target texture
+    struct TextureDesc
+    {
+        GLsizei width;
+        GLsizei height;
+        GLenum  internalFormat;     // e.g. GL_RGBA8, GL_RGBA16F, GL_DEPTH_COMPONENT24
+    };
+
+    /**
+     * Describes a frame as a list of render passes and the textures they read
+     * and write, then works out when each texture is needed.
+     *
+     * Transient textures only exist between the first and last pass that uses
+     * them. Transients whose lifetimes don't overlap share the same GL texture,
+     * so render target memory follows the largest set of textures alive at any
+     * one time rather than the total number of passes. Contents that no later
+     * pass reads are thrown away with glInvalidateFramebuffer where supported.
+     *
+     * Usage, once per frame:
+     *
+     *     graph.reset();
+     *     int scene = graph.createTexture("scene", desc);
+     *     int pass = graph.addPass("scene", drawScene);
+     *     graph.writes(pass, scene);
+     *     ...
+     *     graph.compile();
+     *     graph.execute();
+     *
+     * Physical textures and framebuffers are pooled across frames.
+     */
+    class RenderGraph {
+    public:
+        // Records a pass's GL commands. Its framebuffer and viewport are already set.
+        typedef void (*PassFn)(RenderGraph& graph, void* userData);
+
+        RenderGraph();
+        ~RenderGraph();
+
+        void reset(); // Forgets the passes and resources of the previous frame.
+        void destroy(); // Deletes every pooled texture and framebuffer.
+
+        // Declares a transient texture and returns its resource ID
+        int createTexture(const char* name, const TextureDesc& desc);
+
+        // Declares a texture that outlives the frame (e.g. a cached shadow map).
+        // Imported textures are never aliased, invalidated or culled.
+        int importTexture(const char* name, GLuint texture, const TextureDesc& desc);
+
+        // Declares a pass and returns its ID. Passes run in the order they're added.
+        int addPass(const char* name, PassFn fn, void* userData = NULL);
+
+        void writes(int pass, int resource); // The pass renders into the resource.
+        void reads(int pass, int resource); // The pass samples the resource.
+        // The pass renders to the default framebuffer, which is `width` x `height`
+        void writesBackbuffer(int pass, GLsizei width, GLsizei height);
+
+        // Culls passes that nothing depends on, works out resource lifetimes and
+        // assigns pooled textures to transients
+        void compile();
+
+        // Runs every pass that survived compile()
+        void execute();
+
+        // Returns the GL texture behind a resource. Valid during execute().
+        GLuint getTexture(int resource);
+
+        GLsizeiptr transientBytes(); // Memory the transients would need without aliasing.
+        GLsizeiptr pooledBytes(); // Memory actually held by pooled textures.
+        int passesCulled(); // Number of passes skipped by the last compile().
+
+    private:
+        struct Resource
+        {
+            std::string     name;
+            TextureDesc     desc;
+            GLuint          imported;   // Non-zero for imported textures
+            int             first;      // First and last pass using it, or -1
+            int             last;
+            int             physical;   // Index into _pool for transients
+        };
+
+        struct Pass
+        {
+            std::string         name;
+            PassFn              fn;
+            void*               userData;
+            std::vector<int>    reads;
+            std::vector<int>    writes;
+            bool                backbuffer;
+            GLsizei             backbufferWidth;
+            GLsizei             backbufferHeight;
+            bool                culled;
+        };
+
+        struct PhysicalTexture
+        {
+            GLuint          texture;
+            TextureDesc     desc;
+            bool            inUse;
+            unsigned int    lastFrame;  // Last frame the texture was assigned
+        };
+
+        struct Framebuffer
+        {
+            std::vector<GLuint> attachments;
+            GLuint              fbo;
+            unsigned int        lastFrame;
+        };
+
+        std::vector<Resource> _resources;
+        std::vector<Pass> _passes;
+        std::vector<PhysicalTexture> _pool;
+        std::vector<Framebuffer> _framebuffers;
+        unsigned int _frame;
+        int _culled;
+        bool _canInvalidate;
+
+        int acquire(const TextureDesc& desc, const char* name);
+        GLuint framebufferFor(const Pass& pass);
+        void invalidate(const Pass& pass, int passIndex, bool starting);
+        void trim();
+
+        RenderGraph(const RenderGraph&);
+        RenderGraph& operator=(const RenderGraph&);
+    };
+}
+
+#endif
@@ -0,0 +1,414 @@
+#include "scene.h"
+#include "meshlod.h"
+
+#include <algorithm>
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace GL {
+
+    static const char SCENE_MAGIC[8] = "GLSCENE";
+
+    static size_t alignUp(size_t value, size_t alignment) {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    static size_t pageSize() {
+        static size_t size = (size_t)sysconf(_SC_PAGESIZE);
+        return size;
+    }
+
+    /**
+     * Turns a stored offset into a pointer into the mapping, after checking
+     * that all `count` elements lie inside the file and are aligned.
+     */
+    template<typename T>
+    static bool fixUp(ScenePtr<T>& ptr, uint64_t count, unsigned char* base, size_t size) {
+        if (count == 0) {
+            ptr.pointer = NULL;
+            return true;
+        }
+
+        uint64_t offset = ptr.offset;
+        if (offset % alignof(T) != 0 || offset > size || count > (size - offset) / sizeof(T)) {
+            return false;
+        }
+
+        ptr.pointer = (T*)(base + offset);
+        return true;
+    }
+
+    static bool cellLess(const SceneCell& a, int x, int z) {
+        return a.z != z ? a.z < z : a.x < x;
+    }
+
+
+    // Public
+
+    Scene::Scene() : _mapping(NULL), _size(0), _header(NULL) {}
+
+    Scene::~Scene() {
+        unload();
+    }
+
+    bool Scene::load(const char* path) {
+        unload();
+
+        int fd = open(path, O_RDONLY);
+        if (fd < 0) {
+            return fail(path, "could not open the file");
+        }
+
+        struct stat info;
+        if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(SceneHeader)) {
+            close(fd);
+            return fail(path, "the file is too small");
+        }
+
+        // Private and writable, so offsets can be fixed up in place without
+        // touching the file; pages nobody writes to stay shared with the page cache
+        void* mapping = mmap(NULL, (size_t)info.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        close(fd);
+
+        if (mapping == MAP_FAILED) {
+            return fail(path, "could not map the file");
+        }
+
+        _mapping = (unsigned char*)mapping;
+        _size = (size_t)info.st_size;
+        _header = (SceneHeader*)_mapping;
+
+        SceneHeader& h = *_header;
+        if (memcmp(h.magic, SCENE_MAGIC, sizeof(SCENE_MAGIC)) != 0) {
+            return fail(path, "not a scene file");
+        }
+        if (h.version != SCENE_VERSION || h.headerSize != sizeof(SceneHeader)) {
+            return fail(path, "unsupported version");
+        }
+        if (h.fileSize != _size) {
+            return fail(path, "the file is truncated");
+        }
+
+        if (!fixUp(h.meshes, h.meshCount, _mapping, _size) ||
+            !fixUp(h.textures, h.textureCount, _mapping, _size) ||
+            !fixUp(h.instances, h.instanceCount, _mapping, _size) ||
+            !fixUp(h.cells, h.cellCount, _mapping, _size)) {
+            return fail(path, "a table lies outside the file");
+        }
+
+        // Only the tables are checked; vertex and index data is left
+        // untouched until it is streamed in, where SceneStreamer checks it
+        for (uint32_t i = 0; i < h.meshCount; i++) {
+            SceneMesh& mesh = h.meshes.pointer[i];
+            if (!fixUp(mesh.vertices, mesh.vertexCount, _mapping, _size) ||
+                !fixUp(mesh.indices, mesh.indexCount, _mapping, _size)) {
+                return fail(path, "mesh data lies outside the file");
+            }
+            if (mesh.levelCount == 0 || mesh.levelCount > SCENE_MAX_LEVELS) {
+                return fail(path, "a mesh has a bad number of levels of detail");
+            }
+            for (uint32_t l = 0; l < mesh.levelCount; l++) {
+                const Lod::Level& level = mesh.levels[l];
+                if (level.indexCount < 0 || (uint64_t)level.firstIndex + (uint64_t)level.indexCount > mesh.indexCount) {
+                    return fail(path, "a level of detail lies outside its mesh");
+                }
+            }
+        }
+
+        for (uint32_t i = 0; i < h.textureCount; i++) {
+            SceneTexture& texture = h.textures.pointer[i];
+            if (!fixUp(texture.path, (uint64_t)texture.pathLength + 1, _mapping, _size) ||
+                texture.path.pointer[texture.pathLength] != '\0') {
+                return fail(path, "a texture path is broken");
+            }
+        }
+
+        for (uint32_t i = 0; i < h.instanceCount; i++) {
+            const SceneInstance& instance = h.instances.pointer[i];
+            if (instance.mesh >= h.meshCount ||
+                instance.texture < -1 || instance.texture >= (int32_t)h.textureCount) {
+                return fail(path, "an instance refers to a missing mesh or texture");
+            }
+        }
+
+        for (uint32_t i = 0; i < h.cellCount; i++) {
+            const SceneCell& cell = h.cells.pointer[i];
+            if (cell.firstInstance > h.instanceCount || cell.instanceCount > h.instanceCount - cell.firstInstance) {
+                return fail(path, "a cell refers to missing instances");
+            }
+            if (i > 0 && !cellLess(h.cells.pointer[i - 1], cell.x, cell.z)) {
+                return fail(path, "cells are out of order");
+            }
+        }
+
+        printf("Loading scene: %s (%u meshes, %u textures, %u instances in %u cells)\n",
+               path, h.meshCount, h.textureCount, h.instanceCount, h.cellCount);
+        return true;
+    }
+
+    void Scene::unload() {
+        if (_mapping) {
+            munmap(_mapping, _size);
+        }
+        _mapping = NULL;
+        _size = 0;
+        _header = NULL;
+    }
+
+    const SceneHeader& Scene::header() const {
+        return *_header;
+    }
+
+    const SceneMesh& Scene::mesh(GLuint index) const {
+        return _header->meshes.pointer[index];
+    }
+
+    const SceneTexture& Scene::texture(GLuint index) const {
+        return _header->textures.pointer[index];
+    }
+
+    const SceneInstance& Scene::instance(GLuint index) const {
+        return _header->instances.pointer[index];
+    }
+
+    const SceneCell& Scene::cell(GLuint index) const {
+        return _header->cells.pointer[index];
+    }
+
+    int Scene::findCell(int x, int z) const {
+        const SceneCell* begin = _header->cells.pointer;
+        const SceneCell* end = begin + _header->cellCount;
+        const SceneCell* found = std::lower_bound(begin, end, std::make_pair(x, z),
+            [](const SceneCell& cell, const std::pair<int, int>& key) {
+                return cellLess(cell, key.first, key.second);
+            });
+
+        if (found == end || found->x != x || found->z != z) {
+            return -1;
+        }
+        return (int)(found - begin);
+    }
+
+    void Scene::prefetch(const void* data, size_t size) const {
+        if (size == 0) {
+            return;
+        }
+
+        uintptr_t start = (uintptr_t)data / pageSize() * pageSize();
+        madvise((void*)start, (uintptr_t)data + size - start, MADV_WILLNEED);
+
+        // The advice is only a hint; touching every page makes sure
+        const volatile unsigned char* bytes = (const volatile unsigned char*)data;
+        for (size_t i = 0; i < size; i += pageSize()) {
+            (void)bytes[i];
+        }
+        (void)bytes[size - 1];
+    }
+
+    void Scene::release(const void* data, size_t size) const {
+        // Only whole pages; the ends may be shared with a neighbour
+        uintptr_t start = alignUp((uintptr_t)data, pageSize());
+        uintptr_t end = ((uintptr_t)data + size) / pageSize() * pageSize();
+
+        if (end > start) {
+            madvise((void*)start, end - start, MADV_DONTNEED);
+        }
+    }
+
+
+    // Private
+
+    bool Scene::fail(const char* path, const char* reason) {
+        fprintf(stderr, "Could not load scene %s: %s\n", path, reason);
+        unload();
+        return false;
+    }
+
+
+    // SceneBuilder
+
+    SceneBuilder::SceneBuilder(float cellSize) : _cellSize(cellSize) {}
+
+    GLuint SceneBuilder::addMesh(const std::vector<vertexPosColor>& vertices, const std::vector<GLuint>& indices,
+                                 int levelCount) {
+        Mesh mesh;
+        mesh.vertices = vertices;
+        Lod::generate(vertices, indices, std::min(std::max(levelCount, 1), (int)SCENE_MAX_LEVELS), 0.5f,
+                      mesh.indices, mesh.levels);
+        _meshes.push_back(mesh);
+        return (GLuint)_meshes.size() - 1;
+    }
+
+    GLint SceneBuilder::addTexture(const char* path) {
+        _textures.push_back(path);
+        return (GLint)_textures.size() - 1;
+    }
+
+    void SceneBuilder::addInstance(GLuint mesh, GLint texture, const float model[16]) {
+        SceneInstance instance;
+        memset(&instance, 0, sizeof(instance));
+        memcpy(instance.model, model, sizeof(instance.model));
+        instance.mesh = mesh;
+        instance.texture = texture;
+        _instances.push_back(instance);
+    }
+
+    /**
+     * Builds the whole file in memory, in the order it is mapped: header,
+     * tables, texture paths, then each mesh's vertices and indices starting
+     * on a fresh page.
+     */
+    bool SceneBuilder::write(const char* path) const {
+        struct Placed
+        {
+            SceneInstance   instance;
+            int             x, z;
+        };
+
+        // Group instances by cell, and by mesh within a cell, so each mesh's are drawn together
+        std::vector<Placed> placed(_instances.size());
+        for (size_t i = 0; i < _instances.size(); i++) {
+            placed[i].instance = _instances[i];
+            placed[i].x = (int)floorf(_instances[i].model[12] / _cellSize);
+            placed[i].z = (int)floorf(_instances[i].model[14] / _cellSize);
+        }
+        std::stable_sort(placed.begin(), placed.end(), [](const Placed& a, const Placed& b) {
+            if (a.z != b.z) {
+                return a.z < b.z;
+            }
+            return a.x != b.x ? a.x < b.x : a.instance.mesh < b.instance.mesh;
+        });
+
+        std::vector<float> centers(_meshes.size() * 3);
+        std::vector<float> radii(_meshes.size());
+        for (size_t m = 0; m < _meshes.size(); m++) {
+            Lod::bounds(_meshes[m].vertices, &centers[m * 3], radii[m]);
+        }
+
+        std::vector<SceneCell> cells;
+        for (size_t i = 0; i < placed.size(); i++) {
+            const SceneInstance& instance = placed[i].instance;
+            const float* m = instance.model;
+            const float* c = &centers[instance.mesh * 3];
+
+            // The mesh's bounding sphere, moved and scaled by the model matrix
+            float world[3];
+            float scale = 0.0f;
+            for (int k = 0; k < 3; k++) {
+                world[k] = m[k] * c[0] + m[4 + k] * c[1] + m[8 + k] * c[2] + m[12 + k];
+                scale = std::max(scale, sqrtf(m[k * 4] * m[k * 4] + m[k * 4 + 1] * m[k * 4 + 1] + m[k * 4 + 2] * m[k * 4 + 2]));
+            }
+            float radius = radii[instance.mesh] * scale;
+
+            if (cells.empty() || cells.back().x != placed[i].x || cells.back().z != placed[i].z) {
+                SceneCell cell = { placed[i].x, placed[i].z, (uint32_t)i, 0,
+                                   { world[0] - radius, world[1] - radius, world[2] - radius },
+                                   { world[0] + radius, world[1] + radius, world[2] + radius } };
+                cells.push_back(cell);
+            }
+
+            SceneCell& cell = cells.back();
+            cell.instanceCount++;
+            for (int k = 0; k < 3; k++) {
+                cell.min[k] = std::min(cell.min[k], world[k] - radius);
+                cell.max[k] = std::max(cell.max[k], world[k] + radius);
+            }
+        }
+
+        // Lay out the file
+        size_t offset = sizeof(SceneHeader);
+        size_t meshesOffset = offset;
+        offset += _meshes.size() * sizeof(SceneMesh);
+        size_t texturesOffset = offset;
+        offset += _textures.size() * sizeof(SceneTexture);
+        size_t instancesOffset = offset;
+        offset += placed.size() * sizeof(SceneInstance);
+        size_t cellsOffset = offset;
+        offset += cells.size() * sizeof(SceneCell);
+
+        std::vector<size_t> pathOffsets(_textures.size());
+        for (size_t t = 0; t < _textures.size(); t++) {
+            pathOffsets[t] = offset;
+            offset += _textures[t].size() + 1;
+        }
+
+        std::vector<size_t> vertexOffsets(_meshes.size());
+        std::vector<size_t> indexOffsets(_meshes.size());
+        for (size_t m = 0; m < _meshes.size(); m++) {
+            offset = alignUp(offset, SCENE_PAGE_SIZE);
+            vertexOffsets[m] = offset;
+            offset += _meshes[m].vertices.size() * sizeof(vertexPosColor);
+            offset = alignUp(offset, sizeof(GLuint));
+            indexOffsets[m] = offset;
+            offset += _meshes[m].indices.size() * sizeof(GLuint);
+        }
+
+        std::vector<unsigned char> file(offset, 0);
+        unsigned char* base = &file[0];
+
+        SceneHeader* h = (SceneHeader*)base;
+        memcpy(h->magic, SCENE_MAGIC, sizeof(SCENE_MAGIC));
+        h->version = SCENE_VERSION;
+        h->headerSize = sizeof(SceneHeader);
+        h->fileSize = file.size();
+        h->meshCount = (uint32_t)_meshes.size();
+        h->textureCount = (uint32_t)_textures.size();
+        h->instanceCount = (uint32_t)placed.size();
+        h->cellCount = (uint32_t)cells.size();
+        h->cellSize = _cellSize;
+        h->meshes.offset = meshesOffset;
+        h->textures.offset = texturesOffset;
+        h->instances.offset = instancesOffset;
+        h->cells.offset = cellsOffset;
+
+        for (size_t m = 0; m < _meshes.size(); m++) {
+            SceneMesh* mesh = (SceneMesh*)(base + meshesOffset) + m;
+            mesh->vertices.offset = vertexOffsets[m];
+            mesh->indices.offset = indexOffsets[m];
+            mesh->vertexCount = (uint32_t)_meshes[m].vertices.size();
+            mesh->indexCount = (uint32_t)_meshes[m].indices.size();
+            memcpy(mesh->center, &centers[m * 3], sizeof(mesh->center));
+            mesh->radius = radii[m];
+            mesh->levelCount = (uint32_t)_meshes[m].levels.size();
+            std::copy(_meshes[m].levels.begin(), _meshes[m].levels.end(), mesh->levels);
+
+            if (!_meshes[m].vertices.empty()) {
+                memcpy(base + vertexOffsets[m], &_meshes[m].vertices[0], _meshes[m].vertices.size() * sizeof(vertexPosColor));
+            }
+            if (!_meshes[m].indices.empty()) {
+                memcpy(base + indexOffsets[m], &_meshes[m].indices[0], _meshes[m].indices.size() * sizeof(GLuint));
+            }
+        }
+
+        for (size_t t = 0; t < _textures.size(); t++) {
+            SceneTexture* texture = (SceneTexture*)(base + texturesOffset) + t;
+            texture->path.offset = pathOffsets[t];
+            texture->pathLength = (uint32_t)_textures[t].size();
+            memcpy(base + pathOffsets[t], _textures[t].c_str(), _textures[t].size() + 1);
+        }
+
+        for (size_t i = 0; i < placed.size(); i++) {
+            ((SceneInstance*)(base + instancesOffset))[i] = placed[i].instance;
+        }
+        if (!cells.empty()) {
+            memcpy(base + cellsOffset, &cells[0], cells.size() * sizeof(SceneCell));
+        }
+
+        FILE* fp = fopen(path, "wb");
+        if (!fp) {
+            fprintf(stderr, "Could not write scene: %s\n", path);
+            return false;
+        }
+        bool ok = fwrite(base, 1, file.size(), fp) == file.size();
+        ok = fclose(fp) == 0 && ok;
+
+        printf("Writing scene: %s (%u meshes, %u instances in %u cells, %lu bytes)\n",
+               path, h->meshCount, h->instanceCount, h->cellCount, (unsigned long)file.size());
+        return ok;
+    }
+}
@@ -0,0 +1,168 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include <GL/glew.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "mesh.h"
+#include "meshlod.h"
+
+namespace GL {
+
+    /**
+     * The binary scene format.
+     *
+     * A scene file is laid out exactly as it is used in memory: a header,
+     * tables of meshes, textures, instances and cells, then the bulk vertex
+     * and index data. References between them are stored as file offsets,
+     * which Scene::load() turns into pointers in place once the file is
+     * mapped; nothing else is read or converted. Vertices are stored as
+     * `vertexPosColor` and indices as GLuint, so they go to the GL untouched.
+     * A mesh's indices hold all of its levels of detail one after another,
+     * so every level draws from the same buffers.
+     *
+     * Instances are grouped by the square grid cell (in the XZ plane) they
+     * stand in, so a streamer can bring in the content around the camera one
+     * cell at a time. Each mesh's data starts on its own page, so pages can be
+     * dropped again once no loaded cell uses the mesh.
+     *
+     * Files are written and read in the byte order of the machine.
+     */
+
+    static const uint32_t SCENE_VERSION = 2;
+    static const uint32_t SCENE_PAGE_SIZE = 4096;   // Alignment of each mesh's data
+    static const uint32_t SCENE_MAX_LEVELS = 6;     // Levels of detail per mesh
+
+    // A file offset on disk, and a pointer into the mapping once fixed up
+    template<typename T>
+    union ScenePtr
+    {
+        uint64_t    offset;
+        T*          pointer;
+    };
+
+    struct SceneMesh
+    {
+        ScenePtr<vertexPosColor>    vertices;
+        ScenePtr<GLuint>            indices;
+        uint32_t                    vertexCount;
+        uint32_t                    indexCount;     // Of all levels together
+        float                       center[3];      // Bounding sphere, in object space
+        float                       radius;
+        uint32_t                    levelCount;     // At least 1; level 0 is the full mesh
+        uint32_t                    padding;
+        Lod::Level                  levels[SCENE_MAX_LEVELS];   // Ranges of `indices`
+    };
+
+    struct SceneTexture
+    {
+        ScenePtr<char>  path;           // KTX file, NUL terminated
+        uint32_t        pathLength;
+        uint32_t        padding;
+    };
+
+    struct SceneInstance
+    {
+        float       model[16];          // Column major
+        uint32_t    mesh;
+        int32_t     texture;            // Or -1 for none
+        uint32_t    padding[2];
+    };
+
+    struct SceneCell
+    {
+        int32_t     x;                  // Grid coordinates: floor(position / cellSize)
+        int32_t     z;
+        uint32_t    firstInstance;      // A cell's instances are sorted by mesh
+        uint32_t    instanceCount;
+        float       min[3];             // Bounds of the cell's instances
+        float       max[3];
+    };
+
+    struct SceneHeader
+    {
+        char                    magic[8];       // "GLSCENE"
+        uint32_t                version;
+        uint32_t                headerSize;     // sizeof(SceneHeader), to catch mismatched builds
+        uint64_t                fileSize;
+        uint32_t                meshCount;
+        uint32_t                textureCount;
+        uint32_t                instanceCount;
+        uint32_t                cellCount;      // Sorted by z, then x
+        float                   cellSize;
+        uint32_t                padding;
+        ScenePtr<SceneMesh>     meshes;
+        ScenePtr<SceneTexture>  textures;
+        ScenePtr<SceneInstance> instances;
+        ScenePtr<SceneCell>     cells;
+    };
+
+
+    // A scene file mapped into memory
+    class Scene {
+    public:
+        Scene();
+        ~Scene();
+
+        // Maps the file, checks it and fixes up its offsets. Returns false,
+        // with the reason on stderr, if it isn't a valid scene.
+        bool load(const char* path);
+        void unload();
+
+        const SceneHeader& header() const;
+        const SceneMesh& mesh(GLuint index) const;
+        const SceneTexture& texture(GLuint index) const;
+        const SceneInstance& instance(GLuint index) const;
+        const SceneCell& cell(GLuint index) const;
+
+        int findCell(int x, int z) const; // Returns the index of a cell, or -1 if it is empty.
+
+        // Reads a range of the mapping in ahead of use, so the GL upload doesn't wait on the disk
+        void prefetch(const void* data, size_t size) const;
+        // Lets the OS drop the pages of a range that is no longer needed
+        void release(const void* data, size_t size) const;
+
+    private:
+        bool fail(const char* path, const char* reason);
+
+        unsigned char* _mapping;
+        size_t _size;
+        SceneHeader* _header;
+
+        Scene(const Scene&);
+        Scene& operator=(const Scene&);
+    };
+
+
+    // Collects meshes, textures and instances, and writes them as a scene file
+    class SceneBuilder {
+    public:
+        // `cellSize` is the edge of a streaming cell, in world units
+        explicit SceneBuilder(float cellSize);
+
+        // Generates up to `levelCount` levels of detail (see Lod::generate) for the mesh
+        GLuint addMesh(const std::vector<vertexPosColor>& vertices, const std::vector<GLuint>& indices,
+                       int levelCount = SCENE_MAX_LEVELS);
+        GLint addTexture(const char* path);
+        void addInstance(GLuint mesh, GLint texture, const float model[16]);
+
+        bool write(const char* path) const;
+
+    private:
+        struct Mesh
+        {
+            std::vector<vertexPosColor> vertices;
+            std::vector<GLuint>         indices;    // Every level's
+            std::vector<Lod::Level>     levels;
+        };
+
+        float _cellSize;
+        std::vector<Mesh> _meshes;
+        std::vector<std::string> _textures;
+        std::vector<SceneInstance> _instances;
+    };
+}
+
+#endif
@@ -0,0 +1,505 @@
+#include "scenestreamer.h"
+#include "debugoutput.h"
+
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+
+namespace GL {
+
+    static size_t meshBytes(const SceneMesh& mesh) {
+        return mesh.vertexCount * sizeof(vertexPosColor) + mesh.indexCount * sizeof(GLuint);
+    }
+
+
+    // Public
+
+    SceneStreamer::SceneStreamer()
+        : _scene(NULL), _loadRadius(0.0f), _evictRadius(0.0f), _reach(0.0f), _vao(0), _inFlight(0),
+          _residentBytes(0), _loaded(0), _evicted(0), _quit(false)
+    {
+        _gridMin[0] = _gridMin[1] = 0;
+        _gridMax[0] = _gridMax[1] = -1;
+
+        _vertices.name = "scene vertices";
+        _vertices.buffer = 0;
+        _vertices.elementSize = sizeof(vertexPosColor);
+        _vertices.capacity = 0;
+        _indices.name = "scene indices";
+        _indices.buffer = 0;
+        _indices.elementSize = sizeof(GLuint);
+        _indices.capacity = 0;
+    }
+
+    SceneStreamer::~SceneStreamer() {
+        stop();
+    }
+
+    void SceneStreamer::start(const Scene& scene, float loadRadius, float evictRadius, unsigned int workers) {
+        stop();
+
+        const SceneHeader& h = scene.header();
+        _scene = &scene;
+        _loadRadius = loadRadius;
+        _evictRadius = std::max(evictRadius, loadRadius);
+
+        Cell unloaded = { CELL_UNLOADED, false, 0 };
+        GpuMesh empty = { 0, 0, 0, 0 };
+        _cells.assign(h.cellCount, unloaded);
+        _meshes.assign(h.meshCount, empty);
+        _meshChecks.assign(h.meshCount, MESH_UNCHECKED);
+
+        // The buffers are made on the first upload; the vertex array is
+        // pointed at them again whenever they grow
+        glGenVertexArrays(1, &_vao);
+        DebugOutput::label(GL_VERTEX_ARRAY, _vao, "scene meshes");
+
+        // Instances are filed by their position, but their bounds can stick
+        // out into the neighbouring squares; update() widens its search by that much
+        _reach = 0.0f;
+        _gridMin[0] = _gridMin[1] = 0;
+        _gridMax[0] = _gridMax[1] = -1;
+        for (GLuint c = 0; c < h.cellCount; c++) {
+            const SceneCell& cell = scene.cell(c);
+            float x0 = cell.x * h.cellSize, z0 = cell.z * h.cellSize;
+            _reach = std::max(_reach, std::max(x0 - cell.min[0], cell.max[0] - (x0 + h.cellSize)));
+            _reach = std::max(_reach, std::max(z0 - cell.min[2], cell.max[2] - (z0 + h.cellSize)));
+
+            _gridMin[0] = c == 0 ? cell.x : std::min(_gridMin[0], (int)cell.x);
+            _gridMax[0] = c == 0 ? cell.x : std::max(_gridMax[0], (int)cell.x);
+            _gridMin[1] = c == 0 ? cell.z : std::min(_gridMin[1], (int)cell.z);
+            _gridMax[1] = c == 0 ? cell.z : std::max(_gridMax[1], (int)cell.z);
+        }
+
+        _quit = false;
+        for (unsigned int i = 0; i < std::max(workers, 1u); i++) {
+            _workers.push_back(std::thread(&SceneStreamer::loader, this));
+        }
+
+        printf("Starting scene streamer: %u cells, %u loader threads\n", h.cellCount, (unsigned)_workers.size());
+    }
+
+    void SceneStreamer::stop() {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _quit = true;
+        }
+        _wake.notify_all();
+
+        for (size_t i = 0; i < _workers.size(); i++) {
+            _workers[i].join();
+        }
+        _workers.clear();
+
+        if (_vao) {
+            glDeleteVertexArrays(1, &_vao);
+            _vao = 0;
+        }
+        Arena* arenas[] = { &_vertices, &_indices };
+        for (int i = 0; i < 2; i++) {
+            if (arenas[i]->buffer) {
+                glDeleteBuffers(1, &arenas[i]->buffer);
+            }
+            arenas[i]->buffer = 0;
+            arenas[i]->capacity = 0;
+            arenas[i]->free.clear();
+        }
+
+        _cells.clear();
+        _meshes.clear();
+        _meshChecks.clear();
+        _active.clear();
+        _resident.clear();
+        _uploading.clear();
+        _requests.clear();
+        _ready.clear();
+        _broken.clear();
+        _inFlight = 0;
+        _residentBytes = 0;
+        _scene = NULL;
+    }
+
+    void SceneStreamer::update(const float eye[3]) {
+        // Only cells already asked for can need letting go of
+        for (size_t i = 0; i < _active.size(); ) {
+            GLuint c = _active[i];
+            Cell& cell = _cells[c];
+
+            if (distance(_scene->cell(c), eye) > _evictRadius) {
+                // Cells still on their way are dropped when they arrive
+                cell.wanted = false;
+                if (cell.state == CELL_RESIDENT) {
+                    evict(c);
+                    continue;
+                }
+            }
+            i++;
+        }
+
+        // Only the grid squares in reach can hold cells to ask for
+        std::vector<std::pair<float, GLuint> > requests;
+        float size = _scene->header().cellSize;
+        float reach = _loadRadius + _reach;
+        int x0 = (int)std::max(floorf((eye[0] - reach) / size), (float)_gridMin[0]);
+        int x1 = (int)std::min(floorf((eye[0] + reach) / size), (float)_gridMax[0]);
+        int z0 = (int)std::max(floorf((eye[2] - reach) / size), (float)_gridMin[1]);
+        int z1 = (int)std::min(floorf((eye[2] + reach) / size), (float)_gridMax[1]);
+
+        for (int z = z0; z <= z1; z++) {
+            for (int x = x0; x <= x1; x++) {
+                int c = _scene->findCell(x, z);
+                if (c < 0) {
+                    continue;
+                }
+
+                Cell& cell = _cells[c];
+                float d = distance(_scene->cell(c), eye);
+                if (d <= _loadRadius && cell.state != CELL_BROKEN) {
+                    cell.wanted = true;
+                    if (cell.state == CELL_UNLOADED) {
+                        cell.state = CELL_QUEUED;
+                        requests.push_back(std::make_pair(d, (GLuint)c));
+                        _active.push_back(c);
+                    }
+                }
+            }
+        }
+
+        if (requests.empty()) {
+            return;
+        }
+
+        // Nearest first
+        std::sort(requests.begin(), requests.end());
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            for (size_t i = 0; i < requests.size(); i++) {
+                _requests.push_back(requests[i].second);
+            }
+        }
+        _inFlight += (unsigned)requests.size();
+        _wake.notify_all();
+    }
+
+    size_t SceneStreamer::upload(size_t budget) {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            while (!_ready.empty()) {
+                _cells[_ready.front()].state = CELL_UPLOADING;
+                _uploading.push_back(_ready.front());
+                _ready.pop_front();
+            }
+            while (!_broken.empty()) {
+                _cells[_broken.front()].state = CELL_BROKEN;
+                _cells[_broken.front()].wanted = false;
+                deactivate(_broken.front());
+                _broken.pop_front();
+                _inFlight--;
+            }
+        }
+
+        size_t spent = 0;
+        while (!_uploading.empty()) {
+            GLuint c = _uploading.front();
+            Cell& cell = _cells[c];
+            const SceneCell& sceneCell = _scene->cell(c);
+
+            if (!cell.wanted) {
+                releaseCell(c, cell.progress);
+                cell.state = CELL_UNLOADED;
+                cell.progress = 0;
+                deactivate(c);
+                _uploading.pop_front();
+                _inFlight--;
+                continue;
+            }
+
+            // A cell may take several frames; it picks up where it stopped
+            while (cell.progress < sceneCell.instanceCount) {
+                if (!acquire(sceneCell.firstInstance + cell.progress, spent, budget)) {
+                    return spent;
+                }
+                cell.progress++;
+            }
+
+            cell.state = CELL_RESIDENT;
+            _resident.push_back(c);
+            _uploading.pop_front();
+            _inFlight--;
+            _loaded++;
+        }
+
+        return spent;
+    }
+
+    bool SceneStreamer::isBusy() const {
+        return _inFlight > 0;
+    }
+
+    const std::vector<GLuint>& SceneStreamer::residentCells() const {
+        return _resident;
+    }
+
+    const SceneStreamer::GpuMesh& SceneStreamer::gpuMesh(GLuint mesh) const {
+        return _meshes[mesh];
+    }
+
+    GLuint SceneStreamer::vertexArray() const {
+        return _vao;
+    }
+
+    size_t SceneStreamer::residentBytes() const {
+        return _residentBytes;
+    }
+
+    unsigned long SceneStreamer::cellsLoaded() const {
+        return _loaded;
+    }
+
+    unsigned long SceneStreamer::cellsEvicted() const {
+        return _evicted;
+    }
+
+
+    // Private
+
+    /**
+     * Loader thread: reads in every page of a requested cell's meshes, so the
+     * render thread's upload finds them in memory, and turns the cell down if
+     * one of them is broken.
+     */
+    void SceneStreamer::loader() {
+        for (;;) {
+            GLuint c;
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _wake.wait(lock, [this] { return _quit || !_requests.empty(); });
+                if (_quit) {
+                    return;
+                }
+                c = _requests.front();
+                _requests.pop_front();
+            }
+
+            const SceneCell& cell = _scene->cell(c);
+            std::vector<bool> meshesRead(_scene->header().meshCount, false);
+            bool broken = false;
+
+            for (GLuint i = cell.firstInstance; i < cell.firstInstance + cell.instanceCount && !broken; i++) {
+                const SceneInstance& instance = _scene->instance(i);
+
+                if (!meshesRead[instance.mesh]) {
+                    const SceneMesh& mesh = _scene->mesh(instance.mesh);
+                    _scene->prefetch(mesh.vertices.pointer, mesh.vertexCount * sizeof(vertexPosColor));
+                    _scene->prefetch(mesh.indices.pointer, mesh.indexCount * sizeof(GLuint));
+                    meshesRead[instance.mesh] = true;
+
+                    if (!checkMesh(instance.mesh)) {
+                        fprintf(stderr, "Skipping scene cell %i, %i: mesh %u has indices past its vertices\n",
+                                cell.x, cell.z, instance.mesh);
+                        broken = true;
+                    }
+                }
+            }
+
+            std::lock_guard<std::mutex> lock(_mutex);
+            (broken ? _broken : _ready).push_back(c);
+        }
+    }
+
+    /**
+     * Indices go to the GL as they are, and a bad one would make the GPU fetch
+     * vertices from outside the buffer. Each mesh is scanned by the first
+     * loader to bring it in, right after its pages were read.
+     */
+    bool SceneStreamer::checkMesh(GLuint m) {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (_meshChecks[m] != MESH_UNCHECKED) {
+                return _meshChecks[m] == MESH_VALID;
+            }
+        }
+
+        const SceneMesh& mesh = _scene->mesh(m);
+        GLuint highest = 0;
+        for (uint32_t k = 0; k < mesh.indexCount; k++) {
+            highest = std::max(highest, mesh.indices.pointer[k]);
+        }
+        bool valid = mesh.indexCount == 0 || highest < mesh.vertexCount;
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        _meshChecks[m] = valid ? MESH_VALID : MESH_BROKEN;
+        return valid;
+    }
+
+    /**
+     * Counts an instance as a user of its mesh, uploading it first if nobody
+     * uses it yet. Returns false, having done nothing, if that would take
+     * this call past its budget.
+     */
+    bool SceneStreamer::acquire(GLuint instanceIndex, size_t& spent, size_t budget) {
+        const SceneInstance& instance = _scene->instance(instanceIndex);
+        GpuMesh& mesh = _meshes[instance.mesh];
+        const SceneMesh& sceneMesh = _scene->mesh(instance.mesh);
+
+        bool uploadMesh = mesh.users == 0;
+
+        size_t cost = uploadMesh ? meshBytes(sceneMesh) : 0;
+        if (spent > 0 && spent + cost > budget) {
+            return false;
+        }
+
+        if (uploadMesh) {
+            mesh.baseVertex = (GLint)allocate(_vertices, sceneMesh.vertexCount);
+            mesh.firstIndex = allocate(_indices, sceneMesh.indexCount);
+
+            // Straight from the mapping: the file already holds the GL layout.
+            // The copy target keeps the vertex array's element binding out of it
+            glBindBuffer(GL_COPY_WRITE_BUFFER, _vertices.buffer);
+            glBufferSubData(GL_COPY_WRITE_BUFFER, mesh.baseVertex * sizeof(vertexPosColor),
+                            sceneMesh.vertexCount * sizeof(vertexPosColor), sceneMesh.vertices.pointer);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, _indices.buffer);
+            glBufferSubData(GL_COPY_WRITE_BUFFER, mesh.firstIndex * sizeof(GLuint),
+                            sceneMesh.indexCount * sizeof(GLuint), sceneMesh.indices.pointer);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+            mesh.indexCount = (GLsizei)sceneMesh.indexCount;
+            _residentBytes += meshBytes(sceneMesh);
+        }
+
+        mesh.users++;
+        spent += cost;
+        return true;
+    }
+
+    // Drops the first `count` instances of a cell as users of their meshes
+    void SceneStreamer::releaseCell(GLuint c, GLuint count) {
+        const SceneCell& cell = _scene->cell(c);
+
+        for (GLuint i = cell.firstInstance; i < cell.firstInstance + count; i++) {
+            const SceneInstance& instance = _scene->instance(i);
+            GpuMesh& mesh = _meshes[instance.mesh];
+
+            if (--mesh.users == 0) {
+                const SceneMesh& sceneMesh = _scene->mesh(instance.mesh);
+                release(_vertices, (GLuint)mesh.baseVertex, sceneMesh.vertexCount);
+                release(_indices, mesh.firstIndex, sceneMesh.indexCount);
+                mesh.baseVertex = 0;
+                mesh.firstIndex = 0;
+                mesh.indexCount = 0;
+                _residentBytes -= meshBytes(sceneMesh);
+
+                _scene->release(sceneMesh.vertices.pointer, sceneMesh.vertexCount * sizeof(vertexPosColor));
+                _scene->release(sceneMesh.indices.pointer, sceneMesh.indexCount * sizeof(GLuint));
+            }
+        }
+    }
+
+    void SceneStreamer::evict(GLuint c) {
+        releaseCell(c, _scene->cell(c).instanceCount);
+        _cells[c].state = CELL_UNLOADED;
+        _cells[c].progress = 0;
+
+        _resident.erase(std::find(_resident.begin(), _resident.end(), c));
+        deactivate(c);
+        _evicted++;
+    }
+
+    void SceneStreamer::deactivate(GLuint c) {
+        _active.erase(std::find(_active.begin(), _active.end(), c));
+    }
+
+    /**
+     * Takes the first gap that fits `count` elements. With none, the buffer
+     * grows by at least half again, so a scene that streams in steadily only
+     * grows it a handful of times.
+     */
+    GLuint SceneStreamer::allocate(Arena& arena, GLuint count) {
+        if (count == 0) {
+            return 0;
+        }
+
+        for (size_t i = 0; i < arena.free.size(); i++) {
+            Range& range = arena.free[i];
+            if (range.count >= count) {
+                GLuint first = range.first;
+                range.first += count;
+                range.count -= count;
+                if (range.count == 0) {
+                    arena.free.erase(arena.free.begin() + i);
+                }
+                return first;
+            }
+        }
+
+        GLuint old = arena.capacity;
+        grow(arena, std::max(old + old / 2, old + count));
+        release(arena, old, arena.capacity - old);
+        return allocate(arena, count);
+    }
+
+    // Returns a range to the free list, merging it with the gaps either side
+    void SceneStreamer::release(Arena& arena, GLuint first, GLuint count) {
+        if (count == 0) {
+            return;
+        }
+
+        size_t i = 0;
+        while (i < arena.free.size() && arena.free[i].first < first) {
+            i++;
+        }
+
+        Range range = { first, count };
+        if (i < arena.free.size() && first + count == arena.free[i].first) {
+            range.count += arena.free[i].count;
+            arena.free.erase(arena.free.begin() + i);
+        }
+        if (i > 0 && arena.free[i - 1].first + arena.free[i - 1].count == first) {
+            arena.free[i - 1].count += range.count;
+        } else {
+            arena.free.insert(arena.free.begin() + i, range);
+        }
+    }
+
+    // Moves an arena into a bigger buffer; offsets handed out stay valid
+    void SceneStreamer::grow(Arena& arena, GLuint capacity) {
+        GLuint buffer;
+        glGenBuffers(1, &buffer);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+        glBufferData(GL_COPY_WRITE_BUFFER, capacity * arena.elementSize, NULL, GL_STATIC_DRAW);
+
+        if (arena.buffer) {
+            glBindBuffer(GL_COPY_READ_BUFFER, arena.buffer);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, arena.capacity * arena.elementSize);
+            glBindBuffer(GL_COPY_READ_BUFFER, 0);
+            glDeleteBuffers(1, &arena.buffer);
+        }
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+        printf("Growing %s to %li bytes ID: %i\n", arena.name, (long)(capacity * arena.elementSize), buffer);
+        DebugOutput::label(GL_BUFFER, buffer, arena.name);
+
+        arena.buffer = buffer;
+        arena.capacity = capacity;
+        pointVertexArray();
+    }
+
+    void SceneStreamer::pointVertexArray() {
+        glBindVertexArray(_vao);
+        glBindBuffer(GL_ARRAY_BUFFER, _vertices.buffer);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(vertexPosColor), (void*)offsetof(vertexPosColor, x));
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(vertexPosColor), (void*)offsetof(vertexPosColor, r));
+        glEnableVertexAttribArray(1);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _indices.buffer);
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    // Distance from the eye to a cell's bounds, in the XZ plane
+    float SceneStreamer::distance(const SceneCell& cell, const float eye[3]) const {
+        float dx = std::max(std::max(cell.min[0] - eye[0], eye[0] - cell.max[0]), 0.0f);
+        float dz = std::max(std::max(cell.min[2] - eye[2], eye[2] - cell.max[2]), 0.0f);
+        return sqrtf(dx * dx + dz * dz);
+    }
+}
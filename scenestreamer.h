@@ -0,0 +1,166 @@
+#ifndef SCENESTREAMER_H
+#define SCENESTREAMER_H
+
+#include <GL/glew.h>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "scene.h"
+
+namespace GL {
+
+    /**
+     * Streams a Scene's cells in and out around the camera.
+     *
+     * update() asks for every cell within `loadRadius` of the eye and lets go
+     * of those beyond `evictRadius` (a little further out, so a camera on a
+     * cell border doesn't load and evict the same cell every frame). It only
+     * looks at the grid squares in reach and the cells it already asked for,
+     * so its cost doesn't grow with the size of the scene.
+     *
+     * Requested cells go to background threads, which read the cell's meshes
+     * in from disk and check that their indices stay within their vertices;
+     * a cell with a broken mesh is skipped rather than handed to the GL. The
+     * render thread then uploads them with upload(), spending no more than a
+     * byte budget per frame, so a burst of new cells is spread over several
+     * frames instead of causing a hitch. Meshes are reference counted by the
+     * instances that use them, and freed along with their pages once the last
+     * one is evicted.
+     *
+     * Every resident mesh lives in one shared vertex buffer and one shared
+     * index buffer, drawn through a single vertex array. A mesh is found in
+     * them by its baseVertex and firstIndex, so any mix of meshes can go out
+     * in one multi-draw. The buffers grow when a mesh doesn't fit, and space
+     * freed by evicted meshes is reused.
+     *
+     * Texture references are left alone: scene vertices carry no texture
+     * coordinates, so nothing could sample them.
+     */
+    class SceneStreamer {
+    public:
+        // Where a mesh was uploaded within the shared buffers
+        struct GpuMesh
+        {
+            GLint       baseVertex;
+            GLuint      firstIndex;
+            GLsizei     indexCount;
+            unsigned    users;          // Loaded instances drawing it
+        };
+
+        SceneStreamer();
+        ~SceneStreamer();
+
+        // Starts `workers` loader threads for a loaded scene
+        void start(const Scene& scene, float loadRadius, float evictRadius, unsigned int workers = 2);
+        void stop(); // Joins the loaders and frees everything that was uploaded.
+
+        void update(const float eye[3]); // Requests and evicts cells around `eye`.
+
+        // Uploads loaded cells until `budget` bytes have been sent this call.
+        // At least one mesh goes up per call, however big.
+        // Returns the bytes uploaded.
+        size_t upload(size_t budget);
+
+        bool isBusy() const; // True while requested cells are still on their way.
+
+        const std::vector<GLuint>& residentCells() const; // Cells that can be drawn, in no particular order.
+        const GpuMesh& gpuMesh(GLuint mesh) const; // Only valid for meshes used by a resident cell.
+
+        // Draws from the shared buffers, with the attribute layout of main.cpp
+        GLuint vertexArray() const;
+
+        size_t residentBytes() const; // Bytes of mesh data in the GL
+        unsigned long cellsLoaded() const;
+        unsigned long cellsEvicted() const;
+
+    private:
+        enum CellState
+        {
+            CELL_UNLOADED,
+            CELL_QUEUED,        // With the loader threads
+            CELL_UPLOADING,     // Read in; being uploaded by the render thread
+            CELL_RESIDENT,
+            CELL_BROKEN         // Uses a mesh with bad indices; never loaded
+        };
+
+        enum MeshCheck
+        {
+            MESH_UNCHECKED,
+            MESH_VALID,
+            MESH_BROKEN
+        };
+
+        struct Cell
+        {
+            CellState   state;
+            bool        wanted;
+            GLuint      progress;       // Instances already uploaded and counted
+        };
+
+        // A gap in an arena
+        struct Range
+        {
+            GLuint      first;
+            GLuint      count;
+        };
+
+        // A GL buffer of `elementSize` byte elements, handed out in ranges
+        struct Arena
+        {
+            const char*         name;
+            GLuint              buffer;
+            GLsizeiptr          elementSize;
+            GLuint              capacity;   // In elements
+            std::vector<Range>  free;       // Sorted by first, never touching
+        };
+
+        void loader();
+        bool checkMesh(GLuint mesh);
+        bool acquire(GLuint instance, size_t& spent, size_t budget);
+        void releaseCell(GLuint cell, GLuint count);
+        void evict(GLuint cell);
+        void deactivate(GLuint cell);
+        GLuint allocate(Arena& arena, GLuint count);
+        void release(Arena& arena, GLuint first, GLuint count);
+        void grow(Arena& arena, GLuint capacity);
+        void pointVertexArray();
+        float distance(const SceneCell& cell, const float eye[3]) const;
+
+        const Scene* _scene;
+        float _loadRadius;
+        float _evictRadius;
+        float _reach;                           // Furthest any cell's bounds stick out of its grid square
+        int _gridMin[2];                        // Range of the cells' grid coordinates, x and z
+        int _gridMax[2];
+
+        std::vector<Cell> _cells;
+        std::vector<GpuMesh> _meshes;
+        Arena _vertices;
+        Arena _indices;
+        GLuint _vao;
+        std::vector<GLuint> _active;            // Cells queued, uploading or resident
+        std::vector<GLuint> _resident;
+        std::deque<GLuint> _uploading;          // Cells read in, in upload order
+        unsigned _inFlight;                     // Cells queued or uploading
+        size_t _residentBytes;
+        unsigned long _loaded;
+        unsigned long _evicted;
+
+        // Shared with the loader threads
+        std::mutex _mutex;
+        std::condition_variable _wake;
+        std::deque<GLuint> _requests;
+        std::deque<GLuint> _ready;
+        std::deque<GLuint> _broken;             // Cells the loaders turned down
+        std::vector<char> _meshChecks;          // MeshCheck of each mesh
+        bool _quit;
+        std::vector<std::thread> _workers;
+
+        SceneStreamer(const SceneStreamer&);
+        SceneStreamer& operator=(const SceneStreamer&);
+    };
+}
+
+#endif
@@ -1,4 +1,5 @@
 #include "shader.h"
+#include "debugoutput.h"
 
 namespace GL {
     // Public
@@ -8,11 +9,18 @@ namespace GL {
      * Constructor that creates a shader, sources data into it, and compiles
      * it into code that can be executed by the graphics card
      */
-    Shader::Shader(GLenum type, char* location) {
+    Shader::Shader(GLenum type, const char* location) {
         _handle = glCreateShader(type);
 
         GLchar* src = Util::Files::fileToBuffer(location);
+        if (!src) {
+            fprintf(stderr, "Could not read shader source: %s\n", location);
+            return;
+        }
         glShaderSource(_handle, 1, (const GLchar**)&src, NULL);
+        free(src);
+
+        DebugOutput::label(GL_SHADER, _handle, location);
 
         printf("Compiling Shader: %s ID: %i\n", location, _handle);
         glCompileShader(_handle);
@@ -56,7 +64,7 @@ namespace GL {
     void Shader::createProgramLinkedWithShadersV(
         GLuint& program,
         Shader& vertexShaderConst,
-        GLchar* vertexShaderPath
+        const GLchar* vertexShaderPath
     )
     {
         printf("Creating program linked with Vertex Shader");
@@ -78,7 +86,7 @@ namespace GL {
     void Shader::createProgramLinkedWithShadersF(
         GLuint& program,
         Shader& fragmentShaderConst,
-        GLchar* fragmentShaderPath
+        const GLchar* fragmentShaderPath
     )
     {
         printf("Creating program linked with Vertex Shader");
@@ -102,9 +110,9 @@ namespace GL {
     void Shader::createProgramLinkedWithShadersVF(
         GLuint& program,
         Shader& vertexShaderConst,
-        GLchar* vertexShaderPath,
+        const GLchar* vertexShaderPath,
         Shader& fragmentShaderConst,
-        GLchar* fragmentShaderPath
+        const GLchar* fragmentShaderPath
     )
     {
         printf("Creating program linked with Vertex and Fragment Shaders");
@@ -131,11 +139,11 @@ namespace GL {
     void Shader::createProgramLinkedWithShadersVGF(
         GLuint& program,
         Shader& vertexShaderConst,
-        GLchar* vertexShaderPath,
+        const GLchar* vertexShaderPath,
         Shader& geometryShaderConst,
-        GLchar* geometryShaderPath,
+        const GLchar* geometryShaderPath,
         Shader& fragmentShaderConst,
-        GLchar* fragmentShaderPath
+        const GLchar* fragmentShaderPath
     )
     {
         printf("Creating program linked with Vertex and Fragment Shaders");
@@ -166,9 +174,9 @@ namespace GL {
     void Shader::createProgramWithShadersVF(
         GLuint& program,
         Shader& vertexShaderConst,
-        GLchar* vertexShaderPath,
+        const GLchar* vertexShaderPath,
         Shader& fragmentShaderConst,
-        GLchar* fragmentShaderPath
+        const GLchar* fragmentShaderPath
     )
     {
         program = glCreateProgram();
@@ -181,10 +189,114 @@ namespace GL {
     }
 
 
+    /**
+     * Assigns the named uniform block of a linked program to a binding point,
+     * so that buffers bound with glBindBufferBase/Range at that point feed it.
+     */
+    GLuint Shader::bindUniformBlock(GLuint program, const GLchar* blockName, GLuint bindingPoint) {
+        GLuint blockIndex = glGetUniformBlockIndex(program, blockName);
+
+        if (blockIndex == GL_INVALID_INDEX) {
+            fprintf(stderr, "Uniform block %s not found in program: %i\n", blockName, program);
+            return blockIndex;
+        }
+
+        printf("Binding uniform block: %s to binding point: %i\n", blockName, bindingPoint);
+        glUniformBlockBinding(program, blockIndex, bindingPoint);
+
+        return blockIndex;
+    }
+
+
+    GLint Shader::uniformBlockSize(GLuint program, const GLchar* blockName) {
+        GLuint blockIndex = glGetUniformBlockIndex(program, blockName);
+
+        if (blockIndex == GL_INVALID_INDEX) {
+            return -1;
+        }
+
+        GLint size;
+        glGetActiveUniformBlockiv(program, blockIndex, GL_UNIFORM_BLOCK_DATA_SIZE, &size);
+
+        return size;
+    }
+
+
+    GLint Shader::uniformOffset(GLuint program, const GLchar* uniformName) {
+        GLuint uniformIndex;
+        glGetUniformIndices(program, 1, &uniformName, &uniformIndex);
+
+        if (uniformIndex == GL_INVALID_INDEX) {
+            return -1;
+        }
+
+        GLint offset;
+        glGetActiveUniformsiv(program, 1, &uniformIndex, GL_UNIFORM_OFFSET, &offset);
+
+        return offset;
+    }
+
+
+    /**
+     * The compile-time GL_STD140_* checks only know about the C++ side;
+     * this catches a struct that drifted away from the shader source.
+     */
+    bool Shader::checkUniformBlockSize(GLuint program, const GLchar* blockName, GLsizeiptr expected) {
+        GLint size = uniformBlockSize(program, blockName);
+
+        if (size != expected) {
+            fprintf(stderr, "Uniform block %s is %i bytes in the GL, but %li bytes in C++\n",
+                    blockName, size, (long)expected);
+            return false;
+        }
+
+        return true;
+    }
+
+
+    void Shader::logUniformBlocks(GLuint program) {
+        GLint numBlocks;
+        glGetProgramiv(program, GL_ACTIVE_UNIFORM_BLOCKS, &numBlocks);
+
+        GLint maxNameLength;
+        glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+        GLchar *name = new GLchar[maxNameLength + 1];
+
+        for (GLint block = 0; block < numBlocks; block++) {
+            GLint size, numUniforms, binding;
+            glGetActiveUniformBlockiv(program, block, GL_UNIFORM_BLOCK_DATA_SIZE, &size);
+            glGetActiveUniformBlockiv(program, block, GL_UNIFORM_BLOCK_ACTIVE_UNIFORMS, &numUniforms);
+            glGetActiveUniformBlockiv(program, block, GL_UNIFORM_BLOCK_BINDING, &binding);
+
+            GLint blockNameLength;
+            glGetActiveUniformBlockiv(program, block, GL_UNIFORM_BLOCK_NAME_LENGTH, &blockNameLength);
+            GLchar *blockName = new GLchar[blockNameLength + 1];
+            glGetActiveUniformBlockName(program, block, blockNameLength + 1, NULL, blockName);
+
+            printf("Uniform block: %s size: %i binding: %i\n", blockName, size, binding);
+            delete[] blockName;
+
+            GLint *indices = new GLint[numUniforms];
+            glGetActiveUniformBlockiv(program, block, GL_UNIFORM_BLOCK_ACTIVE_UNIFORM_INDICES, indices);
+
+            for (GLint i = 0; i < numUniforms; i++) {
+                GLuint index = indices[i];
+                GLint offset;
+                glGetActiveUniformsiv(program, 1, &index, GL_UNIFORM_OFFSET, &offset);
+                glGetActiveUniformName(program, index, maxNameLength + 1, NULL, name);
+
+                printf("    %s offset: %i\n", name, offset);
+            }
+            delete[] indices;
+        }
+        delete[] name;
+    }
+
+
     // END Public
 
     // Private
-    void Shader::logError(char* location) {
+    void Shader::logError(const char* location) {
         GLint infoLogLength;
         glGetShaderiv(_handle, GL_INFO_LOG_LENGTH, &infoLogLength);
 
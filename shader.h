@@ -8,7 +8,7 @@ namespace GL {
     class Shader {
     public:
         Shader();
-        Shader(GLenum shaderType, char* shaderLocation);
+        Shader(GLenum shaderType, const char* shaderLocation);
         GLuint getHandle(); // Returns the ID referring to this shader in the GL.
         GLint status(); // Returns the status of compiling the shader.
         void attachTo(GLuint programId); // Attaches the shader to a GL program.
@@ -18,34 +18,34 @@ namespace GL {
         static void createProgramLinkedWithShadersV(
             GLuint& program,            // pointer to the program
             Shader& vertexShaderConst,   // pointer to unCompiled shader object
-            GLchar* vertexShaderPath    // path to the shader source
+            const GLchar* vertexShaderPath    // path to the shader source
         );
 
         // Creates a program linked with a fragment shader
         static void createProgramLinkedWithShadersF(
         GLuint& program,            // pointer to the program
         Shader& fragmentShaderConst,   // pointer to unCompiled shader object
-        GLchar* fragmentShaderPath    // path to the shader source
+        const GLchar* fragmentShaderPath    // path to the shader source
         );
 
         // Creates a program linked with vertex, geometry and fragment shaders
         static void createProgramLinkedWithShadersVGF(
             GLuint& program,            // pointer to the program
             Shader& vertexShaderConst,   // pointer to unCompiled shader object
-            GLchar* vertexShaderPath,    // path to the shader source
+            const GLchar* vertexShaderPath,    // path to the shader source
             Shader& geometryShaderConst,   // pointer to unCompiled shader object
-            GLchar* geometryShaderPath,    // path to the shader source
+            const GLchar* geometryShaderPath,    // path to the shader source
             Shader& fragmentShaderConst,   // pointer to unCompiled shader object
-            GLchar* fragmentShaderPath    // path to the shader source
+            const GLchar* fragmentShaderPath    // path to the shader source
         );
 
         // Creates a program linked with vertex and fragment shaders
         static void createProgramLinkedWithShadersVF(
             GLuint& program,            // pointer to the program
             Shader& vertexShaderConst,   // pointer to unCompiled shader object
-            GLchar* vertexShaderPath,    // path to the shader source
+            const GLchar* vertexShaderPath,    // path to the shader source
             Shader& fragmentShaderConst,   // pointer to unCompiled shader object
-            GLchar* fragmentShaderPath    // path to the shader source
+            const GLchar* fragmentShaderPath    // path to the shader source
         );
 
 
@@ -58,16 +58,44 @@ namespace GL {
         static void createProgramWithShadersVF(
             GLuint& program,            // pointer to the program
             Shader& vertexShaderConst,   // pointer to unCompiled shader object
-            GLchar* vertexShaderPath,    // path to the shader source
+            const GLchar* vertexShaderPath,    // path to the shader source
             Shader& fragmentShaderConst,   // pointer to unCompiled shader object
-            GLchar* fragmentShaderPath    // path to the shader source
+            const GLchar* fragmentShaderPath    // path to the shader source
         );
 
 
+        /**
+        * Uniform block introspection. Blocks are looked up by name on a linked
+        * program; GLSL 4.1 has no `binding` layout qualifier, so binding points
+        * are assigned from here instead.
+        */
+
+        // Assigns a uniform block to a binding point. Returns the block index,
+        // or GL_INVALID_INDEX if the program has no active block of that name.
+        static GLuint bindUniformBlock(
+            GLuint program,             // linked program
+            const GLchar* blockName,    // name of the block in the shader
+            GLuint bindingPoint         // GL_UNIFORM_BUFFER binding point
+        );
+
+        // Returns the size in bytes of a uniform block, or -1 if it is missing
+        static GLint uniformBlockSize(GLuint program, const GLchar* blockName);
+
+        // Returns the byte offset of a block member within its block, or -1
+        static GLint uniformOffset(GLuint program, const GLchar* uniformName);
+
+        // Checks that a C++ mirror of a block has the size the GL expects.
+        // Prints the mismatch and returns false if it doesn't.
+        static bool checkUniformBlockSize(GLuint program, const GLchar* blockName, GLsizeiptr expected);
+
+        // Prints every active uniform block of a program with its members' offsets
+        static void logUniformBlocks(GLuint program);
+
+
 
     private:
         GLuint _handle;
-        void logError(char* location);
+        void logError(const char* location);
     };
 }
 
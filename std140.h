@@ -0,0 +1,84 @@
+#ifndef STD140_H
+#define STD140_H
+
+#include <stddef.h>
+
+/**
+ * C++ mirrors of the GLSL std140 uniform block layout rules.
+ *
+ * Structs built out of these types line up member-for-member with a
+ * `layout (std140) uniform` block, and the GL_STD140_* macros below turn any
+ * mismatch into a compile error instead of garbage on screen.
+ */
+namespace GL {
+namespace Std140 {
+
+    // Scalars are 4-byte aligned, just like in C++
+    typedef float           Float;
+    typedef int             Int;
+    typedef unsigned int    UInt;
+
+    struct alignas(8) vec2
+    {
+        float x, y;
+    };
+
+    // A vec3 is 16-byte aligned. C++ also pads its size to 16, so a scalar
+    // placed after it will not be packed into the 4th slot like GLSL does.
+    // Use a vec4 (or an explicit scalar before the vec3) when that matters.
+    struct alignas(16) vec3
+    {
+        float x, y, z;
+    };
+
+    struct alignas(16) vec4
+    {
+        float x, y, z, w;
+    };
+
+    // Matrices are stored as arrays of column vectors, each padded to a vec4
+    struct alignas(16) mat4
+    {
+        vec4 columns[4];
+    };
+
+    // Array elements are padded out to a multiple of 16 bytes
+    template<typename T>
+    struct alignas(16) element
+    {
+        T value;
+    };
+
+    // Base alignment of each type, as given by the std140 rules
+    template<typename T> struct alignment { static const size_t value = alignof(T); };
+    template<> struct alignment<vec3>     { static const size_t value = 16; };
+    template<> struct alignment<vec4>     { static const size_t value = 16; };
+    template<> struct alignment<mat4>     { static const size_t value = 16; };
+    template<typename T, size_t N>
+    struct alignment<T[N]>                { static const size_t value = 16; };
+
+    // Rounds a size up to the next multiple of `align` (a power of two)
+    constexpr size_t alignUp(size_t size, size_t align)
+    {
+        return (size + (align - 1)) & ~(align - 1);
+    }
+}
+}
+
+// Fails the build if a member's offset breaks its std140 base alignment
+#define GL_STD140_MEMBER(Struct, member)                                            \
+    static_assert(offsetof(Struct, member) %                                        \
+                  GL::Std140::alignment<decltype(Struct::member)>::value == 0,      \
+                  #Struct "::" #member " is not std140 aligned")
+
+// Fails the build if a member does not sit at the offset the GL reports for it
+#define GL_STD140_OFFSET(Struct, member, expected)                                  \
+    static_assert(offsetof(Struct, member) == (expected),                           \
+                  #Struct "::" #member " does not match its std140 offset")
+
+// Fails the build if a block's size is not a multiple of a vec4
+#define GL_STD140_SIZE(Struct)                                                      \
+    static_assert(sizeof(Struct) % 16 == 0,                                         \
+                  #Struct " size is not a multiple of 16 bytes")
+
+#endif
@@ -0,0 +1,16 @@
+#version 410 core
+
+// Copies the previous pass's result, adding a constant to it
+
+uniform sampler2D image;
+uniform vec4 add;
+
+out vec4 outColor;
+
+
+void main(void)
+{
+
+    outColor = texelFetch(image, ivec2(gl_FragCoord.xy), 0) + add;
+
+}
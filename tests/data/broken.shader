@@ -0,0 +1,8 @@
+#version 410 core
+
+out vec4 outColor;
+
+void main(void)
+{
+    outColor = vec4(1.0f, 0.0f, 0.0f, 1.0f)   // missing semicolon
+}
@@ -0,0 +1,11 @@
+#version 410 core
+
+// A single triangle that covers the whole viewport, with no vertex buffer
+
+
+void main()
+{
+    vec2 corner = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    gl_Position = vec4(corner * 2.0f - 1.0f, 0.0f, 1.0f);
+
+}
@@ -0,0 +1,15 @@
+#version 410 core
+
+in vec2 TexCoord;
+
+uniform sampler2D image;
+
+out vec4 outColor;
+
+
+void main(void)
+{
+
+    outColor = texture(image, TexCoord);
+
+}
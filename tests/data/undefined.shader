@@ -0,0 +1,16 @@
+#version 410 core
+
+in vec3 Color;
+
+out vec4 outColor;
+
+// Declared but never defined, so linking must fail
+vec4 shade(vec3 color);
+
+
+void main(void)
+{
+
+    outColor = shade(Color);
+
+}
@@ -0,0 +1,351 @@
+#include "harness.h"
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+
+namespace Test {
+
+    static Case* cases = NULL;
+    static bool updateGolden = false;
+
+    Registrar::Registrar(const char* name, CaseFn fn, unsigned int repeat, bool bench) {
+        Case* c = new Case();
+        c->name = name;
+        c->fn = fn;
+        c->repeat = repeat;
+        c->bench = bench;
+        c->next = NULL;
+
+        // Keep cases in registration order
+        Case** tail = &cases;
+        while (*tail) {
+            tail = &(*tail)->next;
+        }
+        *tail = c;
+    }
+
+    void fail(const char* file, int line, const char* expression) {
+        fprintf(stderr, "    %s:%i: CHECK(%s) failed\n", file, line, expression);
+    }
+
+
+    Target createTarget(int width, int height) {
+        Target target;
+        target.width = width;
+        target.height = height;
+
+        glGenRenderbuffers(1, &target.color);
+        glBindRenderbuffer(GL_RENDERBUFFER, target.color);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+
+        glGenFramebuffers(1, &target.fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, target.fbo);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, target.color);
+        glViewport(0, 0, width, height);
+
+        return target;
+    }
+
+    void destroyTarget(Target& target) {
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glDeleteFramebuffers(1, &target.fbo);
+        glDeleteRenderbuffers(1, &target.color);
+        target.fbo = 0;
+        target.color = 0;
+    }
+
+
+    /**
+     * Golden images are binary PPMs (P6), stored bottom row first, exactly
+     * as glReadPixels returns them.
+     */
+    bool compareGolden(const char* name, const Target& target, int tolerance) {
+        size_t size = target.width * target.height * 3;
+        unsigned char* pixels = new unsigned char[size];
+
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, target.fbo);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadPixels(0, 0, target.width, target.height, GL_RGB, GL_UNSIGNED_BYTE, pixels);
+
+        char path[256];
+        snprintf(path, sizeof(path), "tests/golden/%s.ppm", name);
+
+        if (updateGolden) {
+            FILE* fp = fopen(path, "wb");
+            bool written = fp != NULL;
+            if (fp) {
+                fprintf(fp, "P6\n%i %i\n255\n", target.width, target.height);
+                written = fwrite(pixels, 1, size, fp) == size;
+                fclose(fp);
+            }
+            printf("    recorded %s\n", path);
+            delete[] pixels;
+            return written;
+        }
+
+        FILE* fp = fopen(path, "rb");
+        if (!fp) {
+            fprintf(stderr, "    missing golden image %s (run with --update-golden)\n", path);
+            delete[] pixels;
+            return false;
+        }
+
+        int width = 0, height = 0, maxValue = 0;
+        unsigned char* golden = new unsigned char[size];
+        bool ok = fscanf(fp, "P6 %i %i %i", &width, &height, &maxValue) == 3 &&
+                  fgetc(fp) != EOF &&
+                  width == target.width && height == target.height &&
+                  fread(golden, 1, size, fp) == size;
+        fclose(fp);
+
+        if (!ok) {
+            fprintf(stderr, "    golden image %s is unreadable or the wrong size\n", path);
+        } else {
+            size_t mismatched = 0;
+            int worst = 0;
+            for (size_t i = 0; i < size; i++) {
+                int diff = abs((int)pixels[i] - (int)golden[i]);
+                if (diff > tolerance) {
+                    mismatched++;
+                }
+                if (diff > worst) {
+                    worst = diff;
+                }
+            }
+            if (mismatched) {
+                fprintf(stderr, "    %lu channels differ from %s (worst by %i)\n",
+                        (unsigned long)mismatched, path, worst);
+                ok = false;
+            }
+        }
+
+        delete[] golden;
+        delete[] pixels;
+        return ok;
+    }
+
+
+    bool writeFile(const char* path, const void* data, size_t size) {
+        FILE* fp = fopen(path, "wb");
+        if (!fp) {
+            return false;
+        }
+        bool ok = fwrite(data, 1, size, fp) == size;
+        fclose(fp);
+        return ok;
+    }
+
+
+    const char* captureStderr(void (*fn)(void*), void* userData) {
+        static char output[4096];
+        output[0] = 0;
+
+        FILE* capture = tmpfile();
+        if (!capture) {
+            fn(userData);
+            return output;
+        }
+
+        fflush(stderr);
+        int saved = dup(fileno(stderr));
+        dup2(fileno(capture), fileno(stderr));
+
+        fn(userData);
+
+        fflush(stderr);
+        dup2(saved, fileno(stderr));
+        close(saved);
+
+        rewind(capture);
+        size_t length = fread(output, 1, sizeof(output) - 1, capture);
+        output[length] = 0;
+        fclose(capture);
+
+        return output;
+    }
+
+
+    // Baseline timings, one "<case> <milliseconds>" pair per line
+    static const char* BASELINE_PATH = "tests/perf_baseline.txt";
+
+    static bool readBaseline(const char* name, double& ms) {
+        FILE* fp = fopen(BASELINE_PATH, "r");
+        if (!fp) {
+            return false;
+        }
+
+        char caseName[128];
+        double caseMs;
+        bool found = false;
+        while (fscanf(fp, "%127s %lf", caseName, &caseMs) == 2) {
+            if (strcmp(caseName, name) == 0) {
+                ms = caseMs;
+                found = true;
+            }
+        }
+        fclose(fp);
+
+        return found;
+    }
+
+
+    /**
+     * Creates a GL 4.1 core context with no window or surface at all. Mesa's
+     * surfaceless platform is preferred, since it needs no display server.
+     */
+    static bool createContext() {
+        EGLDisplay display = EGL_NO_DISPLAY;
+
+        PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+            (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+        if (getPlatformDisplay) {
+            display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+        }
+        if (display == EGL_NO_DISPLAY) {
+            display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+        }
+
+        EGLint major, minor;
+        if (!eglInitialize(display, &major, &minor)) {
+            fprintf(stderr, "Failed to initialize EGL.\n");
+            return false;
+        }
+
+        eglBindAPI(EGL_OPENGL_API);
+
+        const EGLint attribs[] = {
+            EGL_CONTEXT_MAJOR_VERSION, 4,
+            EGL_CONTEXT_MINOR_VERSION, 1,
+            EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+            EGL_NONE
+        };
+        EGLContext context = eglCreateContext(display, NULL, EGL_NO_CONTEXT, attribs);
+
+        if (context == EGL_NO_CONTEXT ||
+            !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+            fprintf(stderr, "Failed to create a surfaceless OpenGL 4.1 context.\n");
+            return false;
+        }
+
+        glewExperimental = GL_TRUE;
+        GLenum error = glewInit();
+
+        // A GLX-flavoured GLEW complains that there is no X display,
+        // but it has already loaded every core entry point by then
+        if (error != GLEW_OK && error != GLEW_ERROR_NO_GLX_DISPLAY) {
+            fprintf(stderr, "Failed to initialize GLEW: %s\n", glewGetErrorString(error));
+            return false;
+        }
+
+        printf("OpenGL %s on %s\n", glGetString(GL_VERSION), glGetString(GL_RENDERER));
+        return true;
+    }
+}
+
+
+/**
+ * Usage: run_tests [--bench] [--update-golden] [--update-baseline]
+ *                  [--threshold=<ratio>] [--slack=<ms>] [filter]
+ *
+ * A case fails when its fastest run is slower than its baseline timing
+ * times the threshold (1.5 by default), plus a small absolute slack
+ * (1 ms by default) so that sub-millisecond cases don't flap. Cases with
+ * no baseline yet are appended to tests/perf_baseline.txt. A threshold of
+ * 0 turns timing checks off, e.g. for instrumented PGO training runs.
+ */
+int main(int argc, char** argv) {
+    bool benchOnly = false;
+    bool updateBaseline = false;
+    double threshold = 1.5;
+    double slack = 1.0;
+    const char* filter = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--bench") == 0) {
+            benchOnly = true;
+        } else if (strcmp(argv[i], "--update-golden") == 0) {
+            Test::updateGolden = true;
+        } else if (strcmp(argv[i], "--update-baseline") == 0) {
+            updateBaseline = true;
+        } else if (strncmp(argv[i], "--threshold=", 12) == 0) {
+            threshold = atof(argv[i] + 12);
+        } else if (strncmp(argv[i], "--slack=", 8) == 0) {
+            slack = atof(argv[i] + 8);
+        } else {
+            filter = argv[i];
+        }
+    }
+
+    // Keep case results in step with the failures printed to stderr
+    setvbuf(stdout, NULL, _IOLBF, 0);
+
+    if (!Test::createContext()) {
+        return EXIT_FAILURE;
+    }
+
+    if (updateBaseline) {
+        remove(Test::BASELINE_PATH);
+    }
+
+    int run = 0, failed = 0;
+
+    for (Test::Case* c = Test::cases; c; c = c->next) {
+        if ((benchOnly && !c->bench) || (filter && !strstr(c->name, filter))) {
+            continue;
+        }
+        run++;
+
+        bool passed = true;
+        double best = 0.0;
+
+        for (unsigned int i = 0; i < c->repeat && passed; i++) {
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+            passed = c->fn();
+            glFinish();
+
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            if (i == 0 || ms < best) {
+                best = ms;
+            }
+        }
+
+        GLenum error = glGetError();
+        if (error != GL_NO_ERROR) {
+            fprintf(stderr, "    left GL error 0x%04x behind\n", error);
+            passed = false;
+        }
+
+        double baseline = 0.0;
+        bool regressed = false;
+        if (threshold <= 0.0) {
+            // Timing checks are off
+        } else if (Test::readBaseline(c->name, baseline)) {
+            regressed = passed && best > baseline * threshold + slack;
+        } else if (passed) {
+            FILE* fp = fopen(Test::BASELINE_PATH, "a");
+            if (fp) {
+                fprintf(fp, "%s %.3f\n", c->name, best);
+                fclose(fp);
+            }
+            baseline = best;
+        }
+
+        if (!passed || regressed) {
+            failed++;
+        }
+
+        printf("[%s] %-32s %9.3f ms (baseline %.3f ms)\n",
+               !passed ? "FAIL" : regressed ? "SLOW" : " OK ", c->name, best, baseline);
+    }
+
+    printf("%i of %i cases passed\n", run - failed, run);
+
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
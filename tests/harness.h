@@ -0,0 +1,80 @@
+#ifndef TESTS_HARNESS_H
+#define TESTS_HARNESS_H
+
+#include <stddef.h>
+#include <GL/glew.h>
+
+/**
+ * A tiny self-registering test runner for headless GL tests.
+ *
+ * Cases run inside an offscreen EGL context (Mesa llvmpipe under `make test`),
+ * so rendering is deterministic and pixels can be compared against the golden
+ * images in tests/golden. Every case is also timed; see harness.cpp for how
+ * timings are checked against tests/perf_baseline.txt.
+ */
+namespace Test {
+
+    typedef bool (*CaseFn)();
+
+    struct Case
+    {
+        const char*     name;
+        CaseFn          fn;
+        unsigned int    repeat;     // Times the case is run; the fastest run is reported
+        bool            bench;      // Part of the benchmark scenes (`run_tests --bench`)
+        Case*           next;
+    };
+
+    struct Registrar
+    {
+        Registrar(const char* name, CaseFn fn, unsigned int repeat, bool bench);
+    };
+
+    // Prints a failed check. Used by CHECK().
+    void fail(const char* file, int line, const char* expression);
+
+    // An offscreen framebuffer with a single RGBA8 color attachment
+    struct Target
+    {
+        GLuint  fbo;
+        GLuint  color;
+        int     width;
+        int     height;
+    };
+
+    Target createTarget(int width, int height);
+    void destroyTarget(Target& target);
+
+    // Compares a target's pixels against tests/golden/<name>.ppm.
+    // Channels may differ by `tolerance`; run with --update-golden to re-record.
+    bool compareGolden(const char* name, const Target& target, int tolerance = 2);
+
+    // Writes `size` bytes to a file, returning false on failure
+    bool writeFile(const char* path, const void* data, size_t size);
+
+    // Runs `fn` with stderr redirected, and returns what it printed.
+    // The result is a static buffer, valid until the next call.
+    const char* captureStderr(void (*fn)(void*), void* userData);
+}
+
+#define TEST_CASE_IMPL(name, repeat, bench)                                         \
+    static bool test_##name();                                                      \
+    static Test::Registrar registrar_##name(#name, test_##name, repeat, bench);     \
+    static bool test_##name()
+
+// Defines a correctness case; it is run a few times so its timing is stable
+#define TEST_CASE(name) TEST_CASE_IMPL(name, 3, false)
+
+// Defines a benchmark scene; it is run `repeat` times and also checked for correctness
+#define BENCH_CASE(name, repeat) TEST_CASE_IMPL(name, repeat, true)
+
+// Fails the current case when `expression` is false
+#define CHECK(expression)                                                           \
+    do {                                                                            \
+        if (!(expression)) {                                                        \
+            Test::fail(__FILE__, __LINE__, #expression);                            \
+            return false;                                                           \
+        }                                                                           \
+    } while (0)
+
+#endif
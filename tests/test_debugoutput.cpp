@@ -0,0 +1,121 @@
+#include "harness.h"
+#include "../debugoutput.h"
+
+#include <string.h>
+#include <thread>
+
+
+static void insert(GLenum type, GLuint id, GLenum severity, const char* text) {
+    glDebugMessageInsert(GL_DEBUG_SOURCE_APPLICATION, type, id, severity, -1, text);
+}
+
+static void drainAndEndFrame(void* userData) {
+    GL::DebugOutput* debug = (GL::DebugOutput*)userData;
+    debug->endFrame();
+}
+
+
+TEST_CASE(debug_output_routes_messages) {
+    if (!GL::DebugOutput::isSupported()) {
+        return true;
+    }
+
+    GL::DebugOutput debug;
+    CHECK(debug.install(true));
+
+    insert(GL_DEBUG_TYPE_PERFORMANCE, 1, GL_DEBUG_SEVERITY_MEDIUM, "buffer stall");
+    insert(GL_DEBUG_TYPE_PERFORMANCE, 1, GL_DEBUG_SEVERITY_MEDIUM, "buffer stall");
+    insert(GL_DEBUG_TYPE_PERFORMANCE, 2, GL_DEBUG_SEVERITY_LOW, "shader recompiled");
+    insert(GL_DEBUG_TYPE_ERROR, 3, GL_DEBUG_SEVERITY_HIGH, "broken");
+    insert(GL_DEBUG_TYPE_OTHER, 4, GL_DEBUG_SEVERITY_NOTIFICATION, "filtered out");
+
+    // Nothing is routed until the ring is drained
+    CHECK(debug.errors() == 0);
+    CHECK(debug.performanceWarnings() == 0);
+
+    // Errors go to stderr; the frame's performance summary to stdout
+    const char* printed = Test::captureStderr(drainAndEndFrame, &debug);
+    CHECK(strstr(printed, "GL error (application, high severity) 3: broken") != NULL);
+    CHECK(strstr(printed, "buffer stall") == NULL);
+    CHECK(debug.errors() == 1);
+    CHECK(debug.performanceWarnings() == 3);
+    CHECK(debug.dropped() == 0);
+
+    // A driver-reported error comes through the same way
+    glBindBuffer(GL_ARRAY_BUFFER, 123456);
+    CHECK(glGetError() == GL_INVALID_OPERATION);
+    CHECK(debug.drain() == 1);
+    CHECK(debug.errors() == 2);
+
+    debug.uninstall();
+    insert(GL_DEBUG_TYPE_ERROR, 5, GL_DEBUG_SEVERITY_HIGH, "not listening");
+    CHECK(debug.drain() == 0);
+    return true;
+}
+
+
+TEST_CASE(debug_output_labels_objects) {
+    if (!GL::DebugOutput::isSupported()) {
+        return true;
+    }
+
+    GLuint buffer, texture;
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+
+    GL::DebugOutput::label(GL_BUFFER, buffer, "vertices");
+    GL::DebugOutput::label(GL_TEXTURE, texture, "albedo");
+
+    char label[32];
+    GLsizei length = 0;
+    glGetObjectLabel(GL_BUFFER, buffer, sizeof(label), &length, label);
+    CHECK(strcmp(label, "vertices") == 0);
+    glGetObjectLabel(GL_TEXTURE, texture, sizeof(label), &length, label);
+    CHECK(strcmp(label, "albedo") == 0);
+
+    glDeleteTextures(1, &texture);
+    glDeleteBuffers(1, &buffer);
+    return true;
+}
+
+
+static void postMessages(GL::DebugOutput* debug, int count) {
+    for (int i = 0; i < count; i++) {
+        debug->post(GL_DEBUG_SOURCE_THIRD_PARTY, GL_DEBUG_TYPE_PERFORMANCE, i, GL_DEBUG_SEVERITY_LOW, -1, "slow path");
+    }
+}
+
+// What an asynchronous driver does: several threads reporting at once while
+// the render thread drains. Every message is either delivered or counted.
+TEST_CASE(debug_output_ring_is_thread_safe) {
+    GL::DebugOutput debug;
+    const int threads = 4;
+    const int perThread = 2000;
+
+    std::thread producers[threads];
+    for (int i = 0; i < threads; i++) {
+        producers[i] = std::thread(postMessages, &debug, perThread);
+    }
+
+    size_t drained = 0;
+    for (int i = 0; i < 100; i++) {
+        drained += debug.drain();
+        std::this_thread::yield();
+    }
+    for (int i = 0; i < threads; i++) {
+        producers[i].join();
+    }
+    drained += debug.drain();
+
+    CHECK(drained + debug.dropped() == (size_t)(threads * perThread));
+    CHECK(debug.performanceWarnings() == drained);
+
+    // A full ring drops the overflow instead of blocking
+    GL::DebugOutput full;
+    postMessages(&full, 300);
+    CHECK(full.dropped() == 300 - 256);
+    CHECK(full.drain() == 256);
+    return true;
+}
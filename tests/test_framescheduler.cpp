@@ -0,0 +1,208 @@
+#include "harness.h"
+#include "../framescheduler.h"
+
+#include <math.h>
+
+
+/**
+ * Stands in for the window system and the clock: records what the scheduler
+ * asked for, and moves time forward for timed waits as glfwWaitEventsTimeout
+ * would with no input. Nothing really sleeps, so the timings are exact.
+ */
+struct fakeWindow
+{
+    double  time;           // Seconds
+    int     waits;          // Indefinite waits
+    int     polls;
+    int     intervals[8];   // Swap intervals requested, in order
+    int     intervalCount;
+};
+
+// Every reading takes a little time, so the pacer's final yield loop moves on
+static const double CLOCK_TICK = 1e-5;
+
+static double fakeClock(void* userData) {
+    fakeWindow* window = (fakeWindow*)userData;
+    window->time += CLOCK_TICK;
+    return window->time;
+}
+
+static void fakeWait(double timeout, void* userData) {
+    fakeWindow* window = (fakeWindow*)userData;
+    if (timeout < 0.0) {
+        window->waits++;
+    } else if (timeout == 0.0) {
+        window->polls++;
+    } else {
+        window->time += timeout;
+    }
+}
+
+static void fakeSwapInterval(int interval, void* userData) {
+    fakeWindow* window = (fakeWindow*)userData;
+    if (window->intervalCount < 8) {
+        window->intervals[window->intervalCount++] = interval;
+    }
+}
+
+static void attach(GL::FrameScheduler& scheduler, fakeWindow& window) {
+    scheduler.setClock(fakeClock, &window);
+    scheduler.setWait(fakeWait, &window);
+    scheduler.setSwapInterval(fakeSwapInterval, &window);
+}
+
+// Runs until the scheduler hands out a frame, then "renders" and "swaps"
+static unsigned int frame(GL::FrameScheduler& scheduler, fakeWindow& window, double workMs, double swapMs) {
+    unsigned int dirty;
+    while ((dirty = scheduler.waitForFrame()) == GL::DIRTY_NONE) {}
+
+    window.time += workMs / 1000.0;
+    scheduler.beginSwap();
+    window.time += swapMs / 1000.0;
+    scheduler.endSwap();
+    return dirty;
+}
+
+
+TEST_CASE(scheduler_renders_only_when_dirty) {
+    fakeWindow window = { 0 };
+    GL::FrameScheduler scheduler;
+    attach(scheduler, window);
+
+    // The first frame is always drawn
+    CHECK(scheduler.waitForFrame() == GL::DIRTY_ALL);
+    scheduler.beginSwap();
+    scheduler.endSwap();
+
+    // Then nothing, and the scheduler blocks in the window system
+    CHECK(scheduler.waitForFrame() == GL::DIRTY_NONE);
+    CHECK(scheduler.waitForFrame() == GL::DIRTY_NONE);
+    CHECK(window.waits == 2);
+
+    scheduler.invalidate(GL::DIRTY_VIEW);
+    scheduler.invalidate(GL::DIRTY_RESIZE);
+    CHECK(scheduler.waitForFrame() == (GL::DIRTY_VIEW | GL::DIRTY_RESIZE));
+    scheduler.beginSwap();
+    scheduler.endSwap();
+    CHECK(scheduler.waitForFrame() == GL::DIRTY_NONE);
+
+    // Animation keeps every frame dirty until it stops
+    scheduler.setAnimating(true);
+    CHECK(scheduler.waitForFrame() == GL::DIRTY_ANIMATION);
+    scheduler.beginSwap();
+    scheduler.endSwap();
+    CHECK(scheduler.waitForFrame() == GL::DIRTY_ANIMATION);
+    scheduler.beginSwap();
+    scheduler.endSwap();
+    scheduler.setAnimating(false);
+    CHECK(scheduler.waitForFrame() == GL::DIRTY_NONE);
+
+    CHECK(scheduler.stats().frames == 4);
+    CHECK(window.waits == 4);
+    return true;
+}
+
+
+TEST_CASE(scheduler_paces_to_target_fps) {
+    fakeWindow window = { 0 };
+    GL::FrameScheduler scheduler;
+    attach(scheduler, window);
+    scheduler.setTargetFps(100.0);
+    scheduler.setAnimating(true);
+
+    // Warm up the swap time estimate
+    for (int i = 0; i < 3; i++) {
+        frame(scheduler, window, 1.0, 2.0);
+    }
+
+    const int frames = 20;
+    double start = window.time;
+    double idleStart = scheduler.stats().idleSeconds;
+    double busyStart = scheduler.stats().busySeconds;
+    for (int i = 0; i < frames; i++) {
+        frame(scheduler, window, 1.0, 2.0);
+    }
+    double perFrameMs = (window.time - start) * 1000.0 / frames;
+    double idleMs = (scheduler.stats().idleSeconds - idleStart) * 1000.0 / frames;
+    double busyMs = (scheduler.stats().busySeconds - busyStart) * 1000.0 / frames;
+
+    // 10 ms per frame: 1 ms of work, 2 ms in the swap, and the rest asleep
+    // apart from the last 2 ms, which are yielded away
+    CHECK(fabs(perFrameMs - 10.0) < 0.05);
+    CHECK(scheduler.stats().missed == 0);
+    CHECK(fabs(scheduler.stats().swapMs - 2.0) < 0.05);
+    CHECK(fabs(busyMs - 1.0) < 0.05);
+    CHECK(idleMs > 10.0 - 1.0 - 2.0 - 2.0 - 0.5);
+    return true;
+}
+
+
+TEST_CASE(scheduler_measures_input_latency) {
+    fakeWindow window = { 0 };
+    GL::FrameScheduler scheduler;
+    attach(scheduler, window);
+
+    frame(scheduler, window, 0.0, 0.0);
+    CHECK(scheduler.stats().maxInputLatencyMs == 0.0);
+
+    // Only the first of several inputs before a frame counts
+    scheduler.input();
+    window.time += 0.002;
+    scheduler.input(GL::DIRTY_VIEW);
+    CHECK(frame(scheduler, window, 1.0, 1.0) == (GL::DIRTY_SCENE | GL::DIRTY_VIEW));
+
+    CHECK(fabs(scheduler.stats().inputLatencyMs - 4.0) < 0.05);
+    CHECK(scheduler.stats().maxInputLatencyMs == scheduler.stats().inputLatencyMs);
+    return true;
+}
+
+
+TEST_CASE(scheduler_adapts_swap_interval) {
+    fakeWindow window = { 0 };
+    GL::FrameScheduler scheduler;
+    attach(scheduler, window);
+    scheduler.setRefreshRate(250.0);
+    scheduler.setAdaptiveVsync(true, true);
+    scheduler.setAnimating(true);
+
+    // Frames take longer than a 4 ms refresh, so vsync is given up for late swaps
+    for (int i = 0; i < 12 && window.intervalCount == 0; i++) {
+        frame(scheduler, window, 9.0, 0.0);
+    }
+    CHECK(window.intervalCount == 1);
+    CHECK(window.intervals[0] == -1);
+    CHECK(scheduler.stats().swapInterval == -1);
+
+    // Once they fit again, vsync comes back
+    for (int i = 0; i < 12 && window.intervalCount == 1; i++) {
+        frame(scheduler, window, 0.0, 0.0);
+    }
+    CHECK(window.intervalCount == 2);
+    CHECK(window.intervals[1] == 1);
+
+    // Without tearing support, vsync is turned off instead
+    scheduler.setAdaptiveVsync(true, false);
+    for (int i = 0; i < 12 && window.intervalCount == 2; i++) {
+        frame(scheduler, window, 9.0, 0.0);
+    }
+    CHECK(window.intervalCount == 3);
+    CHECK(window.intervals[2] == 0);
+    return true;
+}
+
+
+// A vsynced swap that blocks for most of the refresh isn't counted as busy
+TEST_CASE(scheduler_busy_time_stops_at_the_swap) {
+    fakeWindow window = { 0 };
+    GL::FrameScheduler scheduler;
+    attach(scheduler, window);
+    scheduler.setAnimating(true);
+
+    for (int i = 0; i < 10; i++) {
+        frame(scheduler, window, 1.0, 15.0);
+    }
+
+    CHECK(fabs(scheduler.stats().busySeconds - 0.010) < 0.0005);
+    CHECK(fabs(scheduler.stats().frameMs - 16.0) < 0.05);
+    return true;
+}
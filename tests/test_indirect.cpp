@@ -0,0 +1,218 @@
+#include "harness.h"
+#include "../indirectbuffer.h"
+#include "../mesh.h"
+#include "../shader.h"
+
+#include <string.h>
+#include <vector>
+
+
+static const char VERTEX_PATH[] = "indirect.vertex.shader";
+static const char FRAGMENT_PATH[] = "fragment.shader";
+
+static const int SIZE = 64;
+static const int GRID = 32;
+
+static const vertexPosColor quad[] = {
+    -0.5f,  0.5f, 0.5f,   1.0f, 0.0f, 0.0f,
+     0.5f,  0.5f, 0.5f,   0.0f, 1.0f, 0.0f,
+     0.5f, -0.5f, 0.5f,   0.0f, 0.0f, 1.0f,
+    -0.5f, -0.5f, 0.5f,   1.0f, 1.0f, 1.0f,
+};
+
+// Mirror of the per-draw attributes in indirect.vertex.shader
+struct perDraw
+{
+    float   model[16];
+    float   tint[4];
+};
+
+// The grid from render_uniform_ring_grid, one draw per cell
+struct Grid
+{
+    int     frame;
+};
+
+static void fillGrid(void* commands, void* drawData, GLuint first, GLuint count, void* userData) {
+    const Grid* grid = (const Grid*)userData;
+    GL::DrawArraysIndirectCommand* command = (GL::DrawArraysIndirectCommand*)commands;
+    perDraw* data = (perDraw*)drawData;
+    float cell = 2.0f / GRID;
+
+    for (GLuint i = first; i < first + count; i++) {
+        int x = i % GRID;
+        int y = i / GRID;
+        float shade = (float)((x + y + grid->frame) % GRID) / GRID;
+
+        GL::DrawArraysIndirectCommand c = { 4, 1, 0, i };
+        command[i] = c;
+
+        perDraw d = {
+            { cell, 0.0f, 0.0f, 0.0f,
+              0.0f, cell, 0.0f, 0.0f,
+              0.0f, 0.0f, 1.0f, 0.0f,
+              -1.0f + cell * (x + 0.5f), -1.0f + cell * (y + 0.5f), 0.0f, 1.0f },
+            { shade, 1.0f - shade, 0.5f, 1.0f }
+        };
+        data[i] = d;
+    }
+}
+
+// Points the per-draw attributes at the data starting at `offset`
+static void pointAttributes(GLuint buffer, GLintptr offset) {
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    for (GLuint column = 0; column < 4; column++) {
+        glVertexAttribPointer(2 + column, 4, GL_FLOAT, GL_FALSE, sizeof(perDraw), (void*)(offset + column * 4 * sizeof(float)));
+        glVertexAttribDivisor(2 + column, 1);
+        glEnableVertexAttribArray(2 + column);
+    }
+    glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(perDraw), (void*)(offset + offsetof(perDraw, tint)));
+    glVertexAttribDivisor(6, 1);
+    glEnableVertexAttribArray(6);
+}
+
+struct Fallback
+{
+    GLuint  buffer;
+    GLuint  draws;
+};
+
+static void pointAtDraw(GLuint draw, GLintptr drawDataOffset, void* userData) {
+    Fallback* fallback = (Fallback*)userData;
+    pointAttributes(fallback->buffer, drawDataOffset);
+    fallback->draws++;
+}
+
+// Renders the grid over a few frames, so the buffer's regions are reused
+static bool renderGrid(bool multiDraw, bool persistent, GLuint& fallbackDraws) {
+    static const int FRAMES = 8;
+
+    Test::Target target = Test::createTarget(SIZE, SIZE);
+
+    GLuint program, vao, vbo;
+    GL::Shader vertex, fragment;
+    GL::Shader::createProgramLinkedWithShadersVF(program, vertex, VERTEX_PATH, fragment, FRAGMENT_PATH);
+
+    glGenVertexArrays(1, &vao);
+    glBindVertexArray(vao);
+    glGenBuffers(1, &vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(quad), quad, GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(vertexPosColor), (void*)offsetof(vertexPosColor, x));
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(vertexPosColor), (void*)offsetof(vertexPosColor, r));
+    glEnableVertexAttribArray(1);
+
+    GL::IndirectBuffer indirect;
+    indirect.create(GRID * GRID, false, sizeof(perDraw), 3, 2, persistent);
+    indirect.setMultiDraw(multiDraw);
+    bool mapping = persistent || !indirect.isPersistent();
+
+    glUseProgram(program);
+    Fallback fallback = { indirect.getHandle(), 0 };
+
+    for (int frame = 0; frame < FRAMES; frame++) {
+        indirect.beginFrame();
+
+        Grid grid = { frame };
+        GLuint count = indirect.fill(GRID * GRID, fillGrid, &grid);
+
+        glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+
+        // baseInstance finds each draw's data from the frame's first
+        pointAttributes(indirect.getHandle(), indirect.drawDataOffset(0));
+        indirect.submit(GL_TRIANGLE_FAN, 0, count, pointAtDraw, &fallback);
+
+        indirect.endFrame();
+    }
+
+    // Drawn the same as with one uniform block per draw
+    bool matches = Test::compareGolden("render_uniform_ring_grid", target);
+    fallbackDraws = fallback.draws;
+
+    indirect.destroy();
+    glDeleteBuffers(1, &vbo);
+    glDeleteVertexArrays(1, &vao);
+    glDeleteProgram(program);
+    Test::destroyTarget(target);
+
+    return matches && mapping;
+}
+
+
+BENCH_CASE(render_indirect_grid, 10) {
+    GLuint fallbackDraws = 0;
+    CHECK(renderGrid(true, true, fallbackDraws));
+
+    // One call per frame where multi-draw is available
+    CHECK(fallbackDraws == (GL::IndirectBuffer::isMultiDrawSupported() ? 0 : 8 * GRID * GRID));
+    return true;
+}
+
+// Without multi-draw: a glDrawArraysIndirect per command
+TEST_CASE(render_indirect_grid_fallback) {
+    GLuint fallbackDraws = 0;
+    CHECK(renderGrid(false, true, fallbackDraws));
+    CHECK(fallbackDraws == 8 * GRID * GRID);
+    return true;
+}
+
+// The buffer mapped for each frame's fill(), as where there is no buffer storage
+TEST_CASE(render_indirect_grid_mapped_per_frame) {
+    GLuint fallbackDraws = 0;
+    CHECK(renderGrid(true, false, fallbackDraws));
+    CHECK(fallbackDraws == (GL::IndirectBuffer::isMultiDrawSupported() ? 0 : 8 * GRID * GRID));
+
+    // GL 4.1, as on OS X: no multi-draw and no buffer storage
+    CHECK(renderGrid(false, false, fallbackDraws));
+    CHECK(fallbackDraws == 8 * GRID * GRID);
+    return true;
+}
+
+
+static void fillIndexed(void* commands, void* drawData, GLuint first, GLuint count, void* userData) {
+    GL::DrawElementsIndirectCommand* command = (GL::DrawElementsIndirectCommand*)commands;
+    GLuint* data = (GLuint*)drawData;
+
+    for (GLuint i = first; i < first + count; i++) {
+        GL::DrawElementsIndirectCommand c = { 3, 1, i * 3, (GLint)i, i };
+        command[i] = c;
+        data[i] = i * 7;
+    }
+}
+
+// Every draw is written exactly once across the workers' slices
+TEST_CASE(indirect_fill_covers_every_draw) {
+    static const GLuint CAPACITY = 10000;
+
+    // Each of multi-draw and persistent mapping on and off
+    for (int mode = 0; mode < 4; mode++) {
+        bool multiDraw = (mode & 1) != 0;
+        bool persistent = (mode & 2) != 0;
+
+        GL::IndirectBuffer indirect;
+        indirect.create(CAPACITY, true, sizeof(GLuint), 2, 3, persistent);
+        indirect.setMultiDraw(multiDraw);
+        CHECK(persistent || !indirect.isPersistent());
+
+        indirect.beginFrame();
+        CHECK(indirect.fill(CAPACITY + 50, fillIndexed, NULL) == CAPACITY);
+
+        std::vector<GL::DrawElementsIndirectCommand> commands(CAPACITY);
+        std::vector<GLuint> data(CAPACITY);
+        glBindBuffer(GL_COPY_READ_BUFFER, indirect.getHandle());
+        glGetBufferSubData(GL_COPY_READ_BUFFER, indirect.commandOffset(0), CAPACITY * sizeof(commands[0]), &commands[0]);
+        glGetBufferSubData(GL_COPY_READ_BUFFER, indirect.drawDataOffset(0), CAPACITY * sizeof(data[0]), &data[0]);
+        indirect.endFrame();
+
+        for (GLuint i = 0; i < CAPACITY; i++) {
+            CHECK(commands[i].count == 3 && commands[i].firstIndex == i * 3 && commands[i].baseVertex == (GLint)i);
+            CHECK(data[i] == i * 7);
+
+            // GL 4.1 requires baseInstance to be 0
+            CHECK(commands[i].baseInstance == (multiDraw ? i : 0));
+        }
+    }
+    return true;
+}
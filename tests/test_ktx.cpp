@@ -0,0 +1,281 @@
+#include "harness.h"
+#include "../Util.h"
+
+#include <string.h>
+
+
+/**
+ * Fixtures are written the way loadKtx() reads them: pixel data follows the
+ * key/value block directly, and `faces` is 0 for anything but a cube map.
+ */
+static const char* KTX_PATH = "tests/fixture.ktx";
+
+static unsigned int swapped(unsigned int u32)
+{
+    return (u32 >> 24) | ((u32 >> 8) & 0xFF00) | ((u32 << 8) & 0xFF0000) | (u32 << 24);
+}
+
+static bool writeKtx(unsigned int width, unsigned int height, unsigned int depth,
+                     unsigned int arrayElements, unsigned int faces, unsigned int mipLevels,
+                     const unsigned char* data, size_t size, bool bigEndian = false)
+{
+    static const unsigned char identifier[] =
+    {
+        0xAB, 0x4B, 0x54, 0x58, 0x20, 0x31, 0x31, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A
+    };
+
+    Util::Files::KTX::header h;
+    memcpy(h.identifier, identifier, sizeof(identifier));
+    h.endianness            = 0x04030201;
+    h.gltype                = GL_UNSIGNED_BYTE;
+    h.gltypesize            = 1;
+    h.glformat              = GL_RGBA;
+    h.glinternalformat      = GL_RGBA8;
+    h.glbaseinternalformat  = GL_RGBA;
+    h.pixelwidth            = width;
+    h.pixelheight           = height;
+    h.pixeldepth            = depth;
+    h.arrayelements         = arrayElements;
+    h.faces                 = faces;
+    h.miplevels             = mipLevels;
+    h.keypairbytes          = 8;
+
+    if (bigEndian)
+    {
+        unsigned int* fields = &h.endianness;
+        for (unsigned int i = 0; i < 13; i++)
+        {
+            fields[i] = swapped(fields[i]);
+        }
+    }
+
+    // One key/value pair's worth of padding that the loader must skip
+    const unsigned char keyValues[8] = { 0 };
+
+    unsigned char* file = new unsigned char[sizeof(h) + sizeof(keyValues) + size];
+    memcpy(file, &h, sizeof(h));
+    memcpy(file + sizeof(h), keyValues, sizeof(keyValues));
+    memcpy(file + sizeof(h) + sizeof(keyValues), data, size);
+
+    bool ok = Test::writeFile(KTX_PATH, file, sizeof(h) + sizeof(keyValues) + size);
+    delete[] file;
+
+    return ok;
+}
+
+// Fills `size` bytes with a pattern that differs from texel to texel
+static unsigned char* makePixels(size_t size)
+{
+    unsigned char* pixels = new unsigned char[size];
+    for (size_t i = 0; i < size; i++)
+    {
+        pixels[i] = (unsigned char)(i * 7 + 3);
+    }
+    return pixels;
+}
+
+// Loads the fixture and checks its target, size and level 0 contents
+static bool loadAndCompare(GLenum target, GLenum imageTarget, int width, int height, int depth,
+                           const unsigned char* expected, size_t size)
+{
+    GLuint texture = Util::Files::KTX::loadKtx(KTX_PATH);
+    CHECK(texture != 0);
+
+    GLint boundTexture = 0;
+    GLenum binding = 0;
+    switch (target)
+    {
+        case GL_TEXTURE_1D:             binding = GL_TEXTURE_BINDING_1D; break;
+        case GL_TEXTURE_1D_ARRAY:       binding = GL_TEXTURE_BINDING_1D_ARRAY; break;
+        case GL_TEXTURE_2D:             binding = GL_TEXTURE_BINDING_2D; break;
+        case GL_TEXTURE_2D_ARRAY:       binding = GL_TEXTURE_BINDING_2D_ARRAY; break;
+        case GL_TEXTURE_3D:             binding = GL_TEXTURE_BINDING_3D; break;
+        case GL_TEXTURE_CUBE_MAP:       binding = GL_TEXTURE_BINDING_CUBE_MAP; break;
+        case GL_TEXTURE_CUBE_MAP_ARRAY: binding = GL_TEXTURE_BINDING_CUBE_MAP_ARRAY; break;
+    }
+    glGetIntegerv(binding, &boundTexture);
+    CHECK((GLuint)boundTexture == texture);
+
+    GLint w = 0, h = 0, d = 0;
+    glGetTexLevelParameteriv(imageTarget, 0, GL_TEXTURE_WIDTH, &w);
+    glGetTexLevelParameteriv(imageTarget, 0, GL_TEXTURE_HEIGHT, &h);
+    glGetTexLevelParameteriv(imageTarget, 0, GL_TEXTURE_DEPTH, &d);
+    CHECK(w == width && h == height && d == depth);
+
+    unsigned char* pixels = new unsigned char[size];
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glGetTexImage(imageTarget, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+    bool same = memcmp(pixels, expected, size) == 0;
+    delete[] pixels;
+
+    glDeleteTextures(1, &texture);
+    remove(KTX_PATH);
+
+    CHECK(same);
+    return true;
+}
+
+
+TEST_CASE(ktx_1d)
+{
+    size_t size = 16 * 4;
+    unsigned char* pixels = makePixels(size);
+    bool ok = writeKtx(16, 0, 0, 0, 0, 0, pixels, size) &&
+              loadAndCompare(GL_TEXTURE_1D, GL_TEXTURE_1D, 16, 1, 1, pixels, size);
+    delete[] pixels;
+    return ok;
+}
+
+TEST_CASE(ktx_1d_array)
+{
+    size_t size = 16 * 3 * 4;
+    unsigned char* pixels = makePixels(size);
+    bool ok = writeKtx(16, 0, 0, 3, 0, 0, pixels, size) &&
+              loadAndCompare(GL_TEXTURE_1D_ARRAY, GL_TEXTURE_1D_ARRAY, 16, 3, 1, pixels, size);
+    delete[] pixels;
+    return ok;
+}
+
+TEST_CASE(ktx_2d)
+{
+    size_t size = 8 * 4 * 4;
+    unsigned char* pixels = makePixels(size);
+    bool ok = writeKtx(8, 4, 0, 0, 0, 0, pixels, size) &&
+              loadAndCompare(GL_TEXTURE_2D, GL_TEXTURE_2D, 8, 4, 1, pixels, size);
+    delete[] pixels;
+    return ok;
+}
+
+TEST_CASE(ktx_2d_mipmapped)
+{
+    // 4x4 base level followed by its 2x2 and 1x1 levels
+    size_t size = (16 + 4 + 1) * 4;
+    unsigned char* pixels = makePixels(size);
+    CHECK(writeKtx(4, 4, 0, 0, 0, 3, pixels, size));
+
+    GLuint texture = Util::Files::KTX::loadKtx(KTX_PATH);
+    remove(KTX_PATH);
+    CHECK(texture != 0);
+
+    GLint levels = 0;
+    glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_IMMUTABLE_LEVELS, &levels);
+    CHECK(levels == 3);
+
+    unsigned char level1[2 * 2 * 4];
+    unsigned char level2[4];
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glGetTexImage(GL_TEXTURE_2D, 1, GL_RGBA, GL_UNSIGNED_BYTE, level1);
+    glGetTexImage(GL_TEXTURE_2D, 2, GL_RGBA, GL_UNSIGNED_BYTE, level2);
+    glDeleteTextures(1, &texture);
+
+    bool same = memcmp(level1, pixels + 16 * 4, sizeof(level1)) == 0 &&
+                memcmp(level2, pixels + 20 * 4, sizeof(level2)) == 0;
+    delete[] pixels;
+
+    CHECK(same);
+    return true;
+}
+
+TEST_CASE(ktx_2d_array)
+{
+    size_t size = 4 * 4 * 2 * 4;
+    unsigned char* pixels = makePixels(size);
+    bool ok = writeKtx(4, 4, 0, 2, 0, 0, pixels, size) &&
+              loadAndCompare(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_2D_ARRAY, 4, 4, 2, pixels, size);
+    delete[] pixels;
+    return ok;
+}
+
+TEST_CASE(ktx_3d)
+{
+    size_t size = 4 * 4 * 4 * 4;
+    unsigned char* pixels = makePixels(size);
+    bool ok = writeKtx(4, 4, 4, 0, 0, 0, pixels, size) &&
+              loadAndCompare(GL_TEXTURE_3D, GL_TEXTURE_3D, 4, 4, 4, pixels, size);
+    delete[] pixels;
+    return ok;
+}
+
+TEST_CASE(ktx_cube_map)
+{
+    size_t faceSize = 4 * 4 * 4;
+    unsigned char* pixels = makePixels(faceSize * 6);
+    bool ok = true;
+
+    // Every face must come from its own slice of the file
+    for (unsigned int face = 0; ok && face < 6; face++)
+    {
+        ok = writeKtx(4, 4, 0, 0, 6, 0, pixels, faceSize * 6) &&
+             loadAndCompare(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_CUBE_MAP_POSITIVE_X + face,
+                            4, 4, 1, pixels + faceSize * face, faceSize);
+    }
+    delete[] pixels;
+    return ok;
+}
+
+TEST_CASE(ktx_cube_map_array)
+{
+    size_t size = 4 * 4 * 6 * 2 * 4;
+    unsigned char* pixels = makePixels(size);
+    bool ok = writeKtx(4, 4, 0, 2, 6, 0, pixels, size) &&
+              loadAndCompare(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_CUBE_MAP_ARRAY, 4, 4, 12, pixels, size);
+    delete[] pixels;
+    return ok;
+}
+
+TEST_CASE(ktx_big_endian_header)
+{
+    size_t size = 8 * 4 * 4;
+    unsigned char* pixels = makePixels(size);
+    bool ok = writeKtx(8, 4, 0, 0, 0, 0, pixels, size, true) &&
+              loadAndCompare(GL_TEXTURE_2D, GL_TEXTURE_2D, 8, 4, 1, pixels, size);
+    delete[] pixels;
+    return ok;
+}
+
+TEST_CASE(ktx_into_existing_texture)
+{
+    size_t size = 8 * 4 * 4;
+    unsigned char* pixels = makePixels(size);
+    CHECK(writeKtx(8, 4, 0, 0, 0, 0, pixels, size));
+    delete[] pixels;
+
+    GLuint texture;
+    glGenTextures(1, &texture);
+    GLuint loaded = Util::Files::KTX::loadKtx(KTX_PATH, texture);
+    remove(KTX_PATH);
+    glDeleteTextures(1, &texture);
+
+    CHECK(loaded == texture);
+    return true;
+}
+
+TEST_CASE(ktx_rejects_bad_files)
+{
+    CHECK(Util::Files::KTX::loadKtx("tests/does-not-exist.ktx") == 0);
+
+    // Truncated header
+    const unsigned char truncated[] = { 0xAB, 0x4B, 0x54, 0x58 };
+    CHECK(Test::writeFile(KTX_PATH, truncated, sizeof(truncated)));
+    CHECK(Util::Files::KTX::loadKtx(KTX_PATH) == 0);
+
+    // Wrong identifier
+    unsigned char pixels[16] = { 0 };
+    CHECK(writeKtx(2, 2, 0, 0, 0, 0, pixels, sizeof(pixels)));
+    FILE* fp = fopen(KTX_PATH, "r+b");
+    CHECK(fp != NULL);
+    fputc('X', fp);
+    fclose(fp);
+    CHECK(Util::Files::KTX::loadKtx(KTX_PATH) == 0);
+
+    // No width
+    CHECK(writeKtx(0, 2, 0, 0, 0, 0, pixels, sizeof(pixels)));
+    CHECK(Util::Files::KTX::loadKtx(KTX_PATH) == 0);
+
+    // Depth without height
+    CHECK(writeKtx(2, 0, 2, 0, 0, 0, pixels, sizeof(pixels)));
+    CHECK(Util::Files::KTX::loadKtx(KTX_PATH) == 0);
+
+    remove(KTX_PATH);
+    return true;
+}
@@ -0,0 +1,346 @@
+#include "harness.h"
+#include "../meshlod.h"
+#include "../shader.h"
+#include "../std140.h"
+#include "../uniformring.h"
+
+#include <algorithm>
+#include <float.h>
+#include <math.h>
+
+
+// A flat grid of `cells` x `cells` quads in the z = 0 plane
+static void buildGrid(int cells, std::vector<vertexPosColor>& vertices, std::vector<GLuint>& indices) {
+    for (int y = 0; y <= cells; y++) {
+        for (int x = 0; x <= cells; x++) {
+            vertexPosColor v = { (float)x / cells - 0.5f, (float)y / cells - 0.5f, 0.0f,
+                                 (float)x / cells, (float)y / cells, 1.0f };
+            vertices.push_back(v);
+        }
+    }
+    for (int y = 0; y < cells; y++) {
+        for (int x = 0; x < cells; x++) {
+            GLuint i = y * (cells + 1) + x;
+            GLuint quad[6] = { i, i + 1, i + cells + 2, i, i + cells + 2, i + cells + 1 };
+            indices.insert(indices.end(), quad, quad + 6);
+        }
+    }
+}
+
+// The grid, red on the left half and blue on the right. The middle column is
+// repeated once in each color, like a color seam in an exported mesh.
+static void buildSeamGrid(int cells, std::vector<vertexPosColor>& vertices, std::vector<GLuint>& indices) {
+    int half = cells / 2;
+    for (int side = 0; side < 2; side++) {
+        for (int y = 0; y <= cells; y++) {
+            for (int x = side * half; x <= half + side * (cells - half); x++) {
+                vertexPosColor v = { (float)x / cells - 0.5f, (float)y / cells - 0.5f, 0.0f,
+                                     side ? 0.0f : 1.0f, 0.0f, side ? 1.0f : 0.0f };
+                vertices.push_back(v);
+            }
+        }
+    }
+
+    GLuint columns = half + 1;
+    GLuint base = 0;
+    for (int side = 0; side < 2; side++) {
+        for (int y = 0; y < cells; y++) {
+            for (GLuint x = 0; x + 1 < columns; x++) {
+                GLuint i = base + y * columns + x;
+                GLuint quad[6] = { i, i + 1, i + columns + 1, i, i + columns + 1, i + columns };
+                indices.insert(indices.end(), quad, quad + 6);
+            }
+        }
+        base += (cells + 1) * columns;
+        columns = cells - half + 1;
+    }
+}
+
+// A lumpy UV sphere. The seam and the poles repeat positions, like a mesh
+// exported with per-face colors would.
+static void buildSphere(int rings, int segments, std::vector<vertexPosColor>& vertices, std::vector<GLuint>& indices) {
+    const float pi = 3.14159265f;
+
+    for (int r = 0; r <= rings; r++) {
+        float theta = pi * r / rings;
+        for (int s = 0; s <= segments; s++) {
+            float phi = 2.0f * pi * (s % segments) / segments;
+            float radius = 1.0f + 0.05f * sinf(5.0f * theta) * cosf(3.0f * phi);
+            vertexPosColor v = { radius * sinf(theta) * cosf(phi), radius * cosf(theta), radius * sinf(theta) * sinf(phi),
+                                 (float)r / rings, (float)s / segments, 0.5f };
+            vertices.push_back(v);
+        }
+    }
+    for (int r = 0; r < rings; r++) {
+        for (int s = 0; s < segments; s++) {
+            GLuint i = r * (segments + 1) + s;
+            GLuint quad[6] = { i, i + segments + 1, i + 1, i + 1, i + segments + 1, i + segments + 2 };
+            indices.insert(indices.end(), quad, quad + 6);
+        }
+    }
+}
+
+
+// Distance from `p` to the closest point of the triangle (a, b, c)
+static float distanceToTriangle(const vertexPosColor& p, const vertexPosColor& a,
+                                const vertexPosColor& b, const vertexPosColor& c) {
+    float ab[3] = { b.x - a.x, b.y - a.y, b.z - a.z };
+    float ac[3] = { c.x - a.x, c.y - a.y, c.z - a.z };
+    float ap[3] = { p.x - a.x, p.y - a.y, p.z - a.z };
+    float bp[3] = { p.x - b.x, p.y - b.y, p.z - b.z };
+    float cp[3] = { p.x - c.x, p.y - c.y, p.z - c.z };
+
+    float d1 = ab[0] * ap[0] + ab[1] * ap[1] + ab[2] * ap[2];
+    float d2 = ac[0] * ap[0] + ac[1] * ap[1] + ac[2] * ap[2];
+    float d3 = ab[0] * bp[0] + ab[1] * bp[1] + ab[2] * bp[2];
+    float d4 = ac[0] * bp[0] + ac[1] * bp[1] + ac[2] * bp[2];
+    float d5 = ab[0] * cp[0] + ab[1] * cp[1] + ab[2] * cp[2];
+    float d6 = ac[0] * cp[0] + ac[1] * cp[1] + ac[2] * cp[2];
+
+    // Barycentric weights of the closest point, walking the triangle's regions
+    float v, w;
+    float va = d3 * d6 - d5 * d4, vb = d5 * d2 - d1 * d6, vc = d1 * d4 - d3 * d2;
+    if (d1 <= 0.0f && d2 <= 0.0f) {
+        v = 0.0f; w = 0.0f;
+    } else if (d3 >= 0.0f && d4 <= d3) {
+        v = 1.0f; w = 0.0f;
+    } else if (d6 >= 0.0f && d5 <= d6) {
+        v = 0.0f; w = 1.0f;
+    } else if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) {
+        v = d1 / (d1 - d3); w = 0.0f;
+    } else if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) {
+        v = 0.0f; w = d2 / (d2 - d6);
+    } else if (va <= 0.0f && d4 - d3 >= 0.0f && d5 - d6 >= 0.0f) {
+        w = (d4 - d3) / ((d4 - d3) + (d5 - d6)); v = 1.0f - w;
+    } else {
+        float denom = 1.0f / (va + vb + vc);
+        v = vb * denom; w = vc * denom;
+    }
+
+    float dx = ap[0] - v * ab[0] - w * ac[0];
+    float dy = ap[1] - v * ab[1] - w * ac[1];
+    float dz = ap[2] - v * ab[2] - w * ac[2];
+    return sqrtf(dx * dx + dy * dy + dz * dz);
+}
+
+
+TEST_CASE(lod_flat_plane_collapses_without_error) {
+    std::vector<vertexPosColor> vertices;
+    std::vector<GLuint> indices;
+    buildGrid(16, vertices, indices);
+
+    float error = -1.0f;
+    std::vector<GLuint> result = GL::Lod::simplify(vertices, indices, 6, 1e-3f, &error);
+
+    // The outline is kept, so a square ends up as two triangles
+    CHECK(result.size() == 6);
+    CHECK(error >= 0.0f && error < 1e-4f);
+
+    float area = 0.0f;
+    for (size_t t = 0; t < result.size(); t += 3) {
+        const vertexPosColor& a = vertices[result[t]];
+        const vertexPosColor& b = vertices[result[t + 1]];
+        const vertexPosColor& c = vertices[result[t + 2]];
+        area += 0.5f * ((b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x));
+    }
+    CHECK(fabsf(area - 1.0f) < 1e-4f);
+    return true;
+}
+
+
+TEST_CASE(lod_seams_keep_their_colors) {
+    std::vector<vertexPosColor> vertices;
+    std::vector<GLuint> indices;
+    buildSeamGrid(16, vertices, indices);
+
+    std::vector<GLuint> result = GL::Lod::simplify(vertices, indices, 12, 1e-3f);
+    CHECK(!result.empty() && result.size() < indices.size() / 4);
+
+    // Every triangle stays on its own side of the seam, in its own color
+    size_t red = 0, blue = 0;
+    for (size_t t = 0; t < result.size(); t += 3) {
+        const vertexPosColor& a = vertices[result[t]];
+        for (int k = 1; k < 3; k++) {
+            const vertexPosColor& b = vertices[result[t + k]];
+            CHECK(a.r == b.r && a.g == b.g && a.b == b.b);
+        }
+        for (int k = 0; k < 3; k++) {
+            const vertexPosColor& v = vertices[result[t + k]];
+            CHECK(a.r == 1.0f ? v.x <= 0.0f : v.x >= 0.0f);
+        }
+        (a.r == 1.0f ? red : blue)++;
+    }
+    CHECK(red > 0 && blue > 0);
+    return true;
+}
+
+
+TEST_CASE(lod_levels_shrink_and_share_vertices) {
+    std::vector<vertexPosColor> vertices;
+    std::vector<GLuint> indices;
+    buildSphere(24, 48, vertices, indices);
+
+    std::vector<GLuint> lodIndices;
+    std::vector<GL::Lod::Level> levels;
+    GL::Lod::generate(vertices, indices, 5, 0.5f, lodIndices, levels);
+
+    CHECK(levels.size() == 5);
+    CHECK(levels[0].indexCount == (GLsizei)indices.size());
+    CHECK(levels[0].error == 0.0f);
+
+    GLuint next = 0;
+    for (size_t l = 0; l < levels.size(); l++) {
+        CHECK(levels[l].firstIndex == next);
+        CHECK(levels[l].indexCount % 3 == 0);
+        next += levels[l].indexCount;
+
+        if (l > 0) {
+            // Close to the requested ratio, and never more accurate than the level before
+            CHECK(levels[l].indexCount <= levels[l - 1].indexCount * 0.55f);
+            CHECK(levels[l].indexCount >= levels[l - 1].indexCount * 0.4f);
+            CHECK(levels[l].error >= levels[l - 1].error);
+        }
+    }
+    CHECK(next == lodIndices.size());
+    CHECK(levels.back().error < 1.0f);
+
+    // Each level's error bounds how far the original vertices are from its surface
+    for (size_t l = 1; l < levels.size(); l++) {
+        float worst = 0.0f;
+        for (size_t i = 0; i < vertices.size(); i++) {
+            float closest = FLT_MAX;
+            for (GLsizei t = 0; t < levels[l].indexCount; t += 3) {
+                const GLuint* corner = &lodIndices[levels[l].firstIndex + t];
+                closest = std::min(closest, distanceToTriangle(vertices[i], vertices[corner[0]],
+                                                               vertices[corner[1]], vertices[corner[2]]));
+            }
+            worst = std::max(worst, closest);
+        }
+        CHECK(worst <= levels[l].error);
+    }
+
+    for (size_t i = 0; i < lodIndices.size(); i++) {
+        CHECK(lodIndices[i] < vertices.size());
+    }
+    return true;
+}
+
+
+TEST_CASE(lod_selection_follows_screen_size) {
+    GL::Lod::Mesh mesh;
+    GL::Lod::Level levels[4] = { { 0, 300, 0.0f }, { 300, 150, 0.01f }, { 450, 75, 0.02f }, { 525, 36, 0.08f } };
+    mesh.levels.assign(levels, levels + 4);
+    mesh.center[0] = mesh.center[1] = mesh.center[2] = 0.0f;
+    mesh.radius = 1.0f;
+
+    // 90 degrees over 1000 pixels: one unit at distance 1 covers 500 pixels
+    GL::Lod::Selector selector(3.14159265f * 0.5f, 1000.0f, 1.0f);
+    CHECK(fabsf(selector.projectedSize(1.0f, 1.0f) - 500.0f) < 0.01f);
+    CHECK(fabsf(selector.projectedSize(2.0f, 10.0f) - 100.0f) < 0.01f);
+
+    CHECK(selector.select(mesh, 0.5f) == 0);
+    CHECK(selector.select(mesh, 5.5f) == 1);
+    CHECK(selector.select(mesh, 12.0f) == 2);
+    CHECK(selector.select(mesh, 1000.0f) == 3);
+
+    int previous = 0;
+    for (float distance = 0.1f; distance < 100.0f; distance *= 1.1f) {
+        int level = selector.select(mesh, distance);
+        CHECK(level >= previous);
+        previous = level;
+    }
+
+    // Instances are measured from the near side of the bounding sphere
+    float positions[] = { 0.0f, 0.0f, -4.0f,   0.0f, 0.0f, -8.0f,   0.0f, 0.0f, -1000.0f };
+    float eye[3] = { 0.0f, 0.0f, 0.0f };
+    int selected[3];
+    selector.select(mesh, positions, 3, eye, selected);
+    CHECK(selected[0] == 0);
+    CHECK(selected[1] == 1);
+    CHECK(selected[2] == 3);
+
+    // A taller framebuffer shows the same error over twice the pixels
+    selector.setViewportHeight(2000.0f);
+    CHECK(fabsf(selector.projectedSize(1.0f, 1.0f) - 1000.0f) < 0.01f);
+    CHECK(selector.select(mesh, 12.0f) == 1);
+    return true;
+}
+
+
+static const char VERTEX_PATH[] = "vertex.shader";
+static const char FRAGMENT_PATH[] = "fragment.shader";
+
+// Mirror of the PerObject block in vertex.shader
+struct perObject
+{
+    GL::Std140::mat4 model;
+    GL::Std140::vec4 tint;
+};
+
+GL_STD140_SIZE(perObject);
+
+BENCH_CASE(lod_generate_and_draw_sphere, 5) {
+    static const int SIZE = 64;
+
+    std::vector<vertexPosColor> vertices;
+    std::vector<GLuint> indices;
+    buildSphere(64, 128, vertices, indices);
+
+    GL::Lod::Mesh mesh;
+    GL::Lod::createMesh(mesh, vertices, indices, 6);
+    CHECK(mesh.levels.size() == 6);
+    CHECK(fabsf(mesh.radius - 1.05f) < 0.05f);
+
+    GL::Lod::Selector selector(3.14159265f / 3.0f, 720.0f);
+    CHECK(selector.select(mesh, 1.0f) == 0);
+    CHECK(selector.select(mesh, 1000.0f) == 5);
+
+    Test::Target target = Test::createTarget(SIZE, SIZE);
+
+    GLuint program;
+    GL::Shader vertex, fragment;
+    GL::Shader::createProgramLinkedWithShadersVF(program, vertex, VERTEX_PATH, fragment, FRAGMENT_PATH);
+    GL::Shader::bindUniformBlock(program, "PerObject", 0);
+
+    // The sphere at 80% of the target, untinted
+    GL::UniformRing uniforms;
+    uniforms.create(sizeof(perObject));
+    uniforms.beginFrame();
+    perObject object = {
+        {{ {0.8f, 0.0f, 0.0f, 0.0f},
+           {0.0f, 0.8f, 0.0f, 0.0f},
+           {0.0f, 0.0f, 0.8f, 0.0f},
+           {0.0f, 0.0f, 0.0f, 1.0f} }},
+        {1.0f, 1.0f, 1.0f, 1.0f}
+    };
+    GLintptr offset = uniforms.push(object);
+    uniforms.flush();
+
+    glUseProgram(program);
+    if (offset >= 0) {
+        uniforms.bindRange<perObject>(0, offset);
+    }
+    glBindVertexArray(mesh.vao);
+
+    // Every level still covers the middle of the target and leaves its corners alone
+    bool covered = offset >= 0;
+    for (float distance = 1.0f; distance < 1000.0f && covered; distance *= 2.0f) {
+        glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+        GL::Lod::draw(mesh, selector.select(mesh, distance));
+
+        unsigned char middle[4], corner[4];
+        glReadPixels(SIZE / 2, SIZE / 2, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, middle);
+        glReadPixels(0, 0, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, corner);
+        covered = covered && middle[2] > 0 && corner[0] == 0 && corner[1] == 0 && corner[2] == 0;
+    }
+    uniforms.endFrame();
+
+    uniforms.destroy();
+    glDeleteProgram(program);
+    Test::destroyTarget(target);
+    GL::Lod::destroyMesh(mesh);
+
+    CHECK(covered);
+    return true;
+}
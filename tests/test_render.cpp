@@ -0,0 +1,260 @@
+#include "harness.h"
+#include "../mesh.h"
+#include "../shader.h"
+#include "../std140.h"
+#include "../uniformring.h"
+
+#include <string.h>
+
+
+/**
+ * Reference scenes. Each renders into a small offscreen target and is
+ * compared against its golden image; the benchmark scenes double as the
+ * training workload for profile-guided builds.
+ */
+
+static const char VERTEX_PATH[] = "vertex.shader";
+static const char FRAGMENT_PATH[] = "fragment.shader";
+static const char TEXTURED_VERTEX_PATH[] = "tests/data/textured_vertex.shader";
+static const char TEXTURED_FRAGMENT_PATH[] = "tests/data/textured_fragment.shader";
+
+static const int SIZE = 64;
+
+static const vertexPosColor quad[] = {
+    -0.5f,  0.5f, 0.5f,   1.0f, 0.0f, 0.0f,
+     0.5f,  0.5f, 0.5f,   0.0f, 1.0f, 0.0f,
+     0.5f, -0.5f, 0.5f,   0.0f, 0.0f, 1.0f,
+    -0.5f, -0.5f, 0.5f,   1.0f, 1.0f, 1.0f,
+};
+
+struct perObject
+{
+    GL::Std140::mat4 model;
+    GL::Std140::vec4 tint;
+};
+
+GL_STD140_SIZE(perObject);
+
+static perObject makeObject(float scale, float x, float y, float r, float g, float b) {
+    perObject object = {
+        {{ {scale, 0.0f,  0.0f, 0.0f},
+           {0.0f,  scale, 0.0f, 0.0f},
+           {0.0f,  0.0f,  1.0f, 0.0f},
+           {x,     y,     0.0f, 1.0f} }},
+        {r, g, b, 1.0f}
+    };
+    return object;
+}
+
+// Uploads the quad and points attributes 0 and 1 at it
+static void createQuad(GLuint& vao, GLuint& vbo) {
+    glGenVertexArrays(1, &vao);
+    glBindVertexArray(vao);
+
+    glGenBuffers(1, &vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(quad), quad, GL_STATIC_DRAW);
+
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(vertexPosColor), (void*)offsetof(vertexPosColor, x));
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(vertexPosColor), (void*)offsetof(vertexPosColor, r));
+    glEnableVertexAttribArray(1);
+}
+
+static void destroyQuad(GLuint& vao, GLuint& vbo) {
+    glDeleteBuffers(1, &vbo);
+    glDeleteVertexArrays(1, &vao);
+}
+
+
+// The demo scene from main.cpp
+TEST_CASE(render_quad) {
+    Test::Target target = Test::createTarget(SIZE, SIZE);
+
+    GLuint program, vao, vbo;
+    GL::Shader vertex, fragment;
+    GL::Shader::createProgramLinkedWithShadersVF(program, vertex, VERTEX_PATH, fragment, FRAGMENT_PATH);
+    GL::Shader::bindUniformBlock(program, "PerObject", 0);
+    createQuad(vao, vbo);
+
+    GL::UniformRing uniforms;
+    uniforms.create(sizeof(perObject));
+    uniforms.beginFrame();
+    GLintptr offset = uniforms.push(makeObject(1.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f));
+    uniforms.flush();
+
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+    glUseProgram(program);
+    if (offset >= 0) {
+        uniforms.bindRange<perObject>(0, offset);
+        glDrawArrays(GL_TRIANGLE_FAN, 0, 4);
+    }
+    uniforms.endFrame();
+
+    bool matches = Test::compareGolden("render_quad", target);
+
+    uniforms.destroy();
+    destroyQuad(vao, vbo);
+    glDeleteProgram(program);
+    Test::destroyTarget(target);
+
+    CHECK(offset >= 0);
+    CHECK(matches);
+    return true;
+}
+
+
+// Pushing past the frame's space is logged and refused rather than overrunning the region
+struct ringPush
+{
+    GL::UniformRing*    uniforms;
+    GLintptr            offset;
+};
+
+static void pushObject(void* push) {
+    ringPush& p = *(ringPush*)push;
+    p.offset = p.uniforms->push(makeObject(1.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f));
+}
+
+TEST_CASE(render_uniform_ring_full_is_logged) {
+    GL::UniformRing uniforms;
+    uniforms.create(sizeof(perObject), 1);
+    uniforms.beginFrame();
+
+    // The region holds one aligned block, so the second push doesn't fit
+    ringPush first = { &uniforms, -1 };
+    ringPush second = { &uniforms, 0 };
+    pushObject(&first);
+    const char* log = Test::captureStderr(pushObject, &second);
+
+    uniforms.endFrame();
+    uniforms.destroy();
+
+    CHECK(first.offset == 0);
+    CHECK(second.offset == -1);
+    CHECK(strstr(log, "is full") != NULL);
+    return true;
+}
+
+
+// A grid of objects, each with its own constants streamed through the ring
+BENCH_CASE(render_uniform_ring_grid, 10) {
+    static const int GRID = 32;
+    static const int FRAMES = 8;
+
+    Test::Target target = Test::createTarget(SIZE, SIZE);
+
+    GLuint program, vao, vbo;
+    GL::Shader vertex, fragment;
+    GL::Shader::createProgramLinkedWithShadersVF(program, vertex, VERTEX_PATH, fragment, FRAGMENT_PATH);
+    GL::Shader::bindUniformBlock(program, "PerObject", 0);
+    createQuad(vao, vbo);
+
+    GL::UniformRing uniforms;
+    uniforms.create(GRID * GRID * sizeof(perObject));
+
+    GLintptr offsets[GRID * GRID];
+    float cell = 2.0f / GRID;
+    bool pushed = true;
+
+    glUseProgram(program);
+
+    for (int frame = 0; frame < FRAMES; frame++) {
+        uniforms.beginFrame();
+
+        for (int y = 0; y < GRID; y++) {
+            for (int x = 0; x < GRID; x++) {
+                float shade = (float)((x + y + frame) % GRID) / GRID;
+                offsets[y * GRID + x] = uniforms.push(makeObject(
+                    cell, -1.0f + cell * (x + 0.5f), -1.0f + cell * (y + 0.5f),
+                    shade, 1.0f - shade, 0.5f
+                ));
+                pushed = pushed && offsets[y * GRID + x] >= 0;
+            }
+        }
+        uniforms.flush();
+
+        glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+
+        for (int i = 0; i < GRID * GRID && pushed; i++) {
+            uniforms.bindRange<perObject>(0, offsets[i]);
+            glDrawArrays(GL_TRIANGLE_FAN, 0, 4);
+        }
+
+        uniforms.endFrame();
+    }
+
+    bool matches = Test::compareGolden("render_uniform_ring_grid", target);
+
+    uniforms.destroy();
+    destroyQuad(vao, vbo);
+    glDeleteProgram(program);
+    Test::destroyTarget(target);
+
+    CHECK(pushed);
+    CHECK(matches);
+    return true;
+}
+
+
+// A full-screen quad sampling a texture that went through loadKtx()
+TEST_CASE(render_ktx_textured) {
+    static const unsigned int TEXELS = 4;
+
+    // A KTX file in the layout loadKtx() reads: header, key/values, pixels
+    unsigned char file[sizeof(Util::Files::KTX::header) + TEXELS * TEXELS * 4];
+    Util::Files::KTX::header h = {
+        { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x31, 0x31, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A },
+        0x04030201, GL_UNSIGNED_BYTE, 1, GL_RGBA, GL_RGBA8, GL_RGBA,
+        TEXELS, TEXELS, 0, 0, 0, 1, 0
+    };
+    memcpy(file, &h, sizeof(h));
+
+    unsigned char* texels = file + sizeof(h);
+    for (unsigned int i = 0; i < TEXELS * TEXELS; i++) {
+        texels[i * 4 + 0] = (unsigned char)(i * 16);
+        texels[i * 4 + 1] = (unsigned char)(255 - i * 16);
+        texels[i * 4 + 2] = (i % 2) ? 255 : 0;
+        texels[i * 4 + 3] = 255;
+    }
+    CHECK(Test::writeFile("tests/textured.ktx", file, sizeof(file)));
+
+    GLuint texture = Util::Files::KTX::loadKtx("tests/textured.ktx");
+    remove("tests/textured.ktx");
+    CHECK(texture != 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    Test::Target target = Test::createTarget(SIZE, SIZE);
+
+    GLuint program, vao, vbo;
+    GL::Shader vertex, fragment;
+    GL::Shader::createProgramLinkedWithShadersVF(program, vertex, TEXTURED_VERTEX_PATH, fragment, TEXTURED_FRAGMENT_PATH);
+    createQuad(vao, vbo);
+
+    // Stretch the quad over the whole target
+    static const GLfloat corners[] = { -1.0f, 1.0f, 1.0f, 1.0f, 1.0f, -1.0f, -1.0f, -1.0f };
+    for (int i = 0; i < 4; i++) {
+        glBufferSubData(GL_ARRAY_BUFFER, i * sizeof(vertexPosColor), 2 * sizeof(GLfloat), corners + i * 2);
+    }
+
+    glUseProgram(program);
+    glUniform1i(glGetUniformLocation(program, "image"), 0);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, texture);
+
+    glClear(GL_COLOR_BUFFER_BIT);
+    glDrawArrays(GL_TRIANGLE_FAN, 0, 4);
+
+    bool matches = Test::compareGolden("render_ktx_textured", target, 0);
+
+    destroyQuad(vao, vbo);
+    glDeleteProgram(program);
+    glDeleteTextures(1, &texture);
+    Test::destroyTarget(target);
+
+    CHECK(matches);
+    return true;
+}
@@ -0,0 +1,211 @@
+#include "harness.h"
+#include "../rendergraph.h"
+#include "../shader.h"
+
+#include <stdlib.h>
+
+
+static const char FULLSCREEN_PATH[] = "tests/data/fullscreen_vertex.shader";
+static const char ACCUMULATE_PATH[] = "tests/data/accumulate_fragment.shader";
+
+static const int SIZE = 64;
+static const int CHAIN = 5;
+
+struct chainPass
+{
+    GLuint  program;
+    int     input;      // Resource sampled by the pass, or -1 to start the chain
+};
+
+// Clears, or adds 0.1 red to the previous pass's output
+static void accumulate(GL::RenderGraph& graph, void* userData) {
+    chainPass* pass = (chainPass*)userData;
+
+    if (pass->input == -1) {
+        glClearColor(0.1f, 0.0f, 0.0f, 1.0f);
+        glClearDepth(1.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        return;
+    }
+
+    glUseProgram(pass->program);
+    glUniform4f(glGetUniformLocation(pass->program, "add"), 0.1f, 0.0f, 0.0f, 0.0f);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, graph.getTexture(pass->input));
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+}
+
+static void neverRuns(GL::RenderGraph& graph, void* userData) {
+    *(bool*)userData = true;
+}
+
+// Records the viewport the pass was handed
+static void recordViewport(GL::RenderGraph& graph, void* userData) {
+    glGetIntegerv(GL_VIEWPORT, (GLint*)userData);
+}
+
+/**
+ * A post-processing style chain: a scene pass with a depth buffer, then
+ * CHAIN passes that each read the previous output, ending in a persistent
+ * texture. Plus one pass whose output nobody reads.
+ */
+static void buildChain(GL::RenderGraph& graph, chainPass* passes, GLuint output, bool* culledRan) {
+    GL::TextureDesc color = { SIZE, SIZE, GL_RGBA8 };
+    GL::TextureDesc depth = { SIZE, SIZE, GL_DEPTH_COMPONENT24 };
+
+    graph.reset();
+
+    int previous = graph.createTexture("scene", color);
+    int sceneDepth = graph.createTexture("scene depth", depth);
+    int scene = graph.addPass("scene", accumulate, &passes[0]);
+    graph.writes(scene, previous);
+    graph.writes(scene, sceneDepth);
+
+    int unused = graph.createTexture("unused", color);
+    int unusedPass = graph.addPass("unused", neverRuns, culledRan);
+    graph.writes(unusedPass, unused);
+
+    for (int i = 1; i <= CHAIN; i++) {
+        int target = i == CHAIN ? graph.importTexture("output", output, color)
+                                : graph.createTexture("post", color);
+        passes[i].input = previous;
+
+        int pass = graph.addPass("post", accumulate, &passes[i]);
+        graph.reads(pass, previous);
+        graph.writes(pass, target);
+        previous = target;
+    }
+}
+
+
+BENCH_CASE(rendergraph_post_chain, 10) {
+    GLuint program;
+    GL::Shader vertex, fragment;
+    GL::Shader::createProgramLinkedWithShadersVF(program, vertex, FULLSCREEN_PATH, fragment, ACCUMULATE_PATH);
+
+    GLuint vao;
+    glGenVertexArrays(1, &vao);
+    glBindVertexArray(vao);
+
+    GLuint output;
+    glGenTextures(1, &output);
+    glBindTexture(GL_TEXTURE_2D, output);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, SIZE, SIZE);
+
+    chainPass passes[CHAIN + 1];
+    for (int i = 0; i <= CHAIN; i++) {
+        passes[i].program = program;
+        passes[i].input = -1;
+    }
+
+    GL::RenderGraph graph;
+    bool culledRan = false;
+
+    GLsizeiptr pooled = 0;
+    GLuint sceneTexture = 0;
+    for (int frame = 0; frame < 4; frame++) {
+        buildChain(graph, passes, output, &culledRan);
+        graph.compile();
+        graph.execute();
+
+        // The pool stops growing after the first frame
+        if (frame == 0) {
+            pooled = graph.pooledBytes();
+            sceneTexture = graph.getTexture(0);
+        }
+        CHECK(graph.pooledBytes() == pooled);
+        CHECK(graph.getTexture(0) == sceneTexture);
+    }
+
+    // Five color transients, but never more than two alive at once,
+    // plus the scene's depth buffer
+    CHECK(graph.passesCulled() == 1);
+    CHECK(!culledRan);
+    CHECK(graph.transientBytes() == 6 * SIZE * SIZE * 4);
+    CHECK(pooled == 3 * SIZE * SIZE * 4);
+
+    unsigned char pixels[SIZE * SIZE * 4];
+    glBindTexture(GL_TEXTURE_2D, output);
+    glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+
+    graph.destroy();
+    glDeleteTextures(1, &output);
+    glDeleteVertexArrays(1, &vao);
+    glDeleteProgram(program);
+
+    // 0.1 from the clear, plus 0.1 from each of the CHAIN passes
+    int expected = (int)((CHAIN + 1) * 0.1f * 255.0f + 0.5f);
+    CHECK(abs(pixels[0] - expected) <= 3);
+    CHECK(abs(pixels[(SIZE * SIZE - 1) * 4] - expected) <= 3);
+    CHECK(pixels[1] == 0 && pixels[2] == 0);
+    return true;
+}
+
+
+TEST_CASE(rendergraph_reuses_only_matching_textures) {
+    GL::TextureDesc small = { 16, 16, GL_RGBA8 };
+    GL::TextureDesc large = { 32, 32, GL_RGBA8 };
+    GL::TextureDesc hdr = { 16, 16, GL_RGBA16F };
+    GLuint output;
+    glGenTextures(1, &output);
+
+    GL::RenderGraph graph;
+    int a = graph.createTexture("a", small);
+    int b = graph.createTexture("b", large);
+    int c = graph.createTexture("c", small);
+    int d = graph.createTexture("d", hdr);
+    int out = graph.importTexture("out", output, small);
+
+    // `a` is dead once `b` has been made from it
+    int pa = graph.addPass("a", neverRuns, NULL);
+    graph.writes(pa, a);
+    int pb = graph.addPass("b", neverRuns, NULL);
+    graph.reads(pb, a);
+    graph.writes(pb, b);
+    int pc = graph.addPass("c", neverRuns, NULL);
+    graph.writes(pc, c);
+    int pd = graph.addPass("d", neverRuns, NULL);
+    graph.writes(pd, d);
+    int resolve = graph.addPass("resolve", neverRuns, NULL);
+    graph.reads(resolve, b);
+    graph.reads(resolve, c);
+    graph.reads(resolve, d);
+    graph.writes(resolve, out);
+
+    graph.compile();
+
+    // `c` takes over `a`'s texture; `d` has the same size but another format
+    CHECK(graph.getTexture(c) == graph.getTexture(a));
+    CHECK(graph.getTexture(d) != graph.getTexture(a));
+    CHECK(graph.getTexture(b) != graph.getTexture(a));
+    CHECK(graph.getTexture(out) == output);
+    CHECK(graph.pooledBytes() == graph.transientBytes() - 16 * 16 * 4);
+
+    graph.destroy();
+    glDeleteTextures(1, &output);
+    return true;
+}
+
+
+// A backbuffer pass after a smaller offscreen pass gets the window's viewport back
+TEST_CASE(rendergraph_sets_backbuffer_viewport) {
+    GL::TextureDesc small = { 16, 16, GL_RGBA8 };
+    GLint offscreen[4] = { 0 };
+    GLint backbuffer[4] = { 0 };
+
+    GL::RenderGraph graph;
+    int half = graph.createTexture("half", small);
+    int downsample = graph.addPass("downsample", recordViewport, offscreen);
+    graph.writes(downsample, half);
+    int present = graph.addPass("present", recordViewport, backbuffer);
+    graph.reads(present, half);
+    graph.writesBackbuffer(present, SIZE, SIZE / 2);
+
+    graph.compile();
+    graph.execute();
+    graph.destroy();
+
+    CHECK(offscreen[0] == 0 && offscreen[1] == 0 && offscreen[2] == 16 && offscreen[3] == 16);
+    CHECK(backbuffer[0] == 0 && backbuffer[1] == 0 && backbuffer[2] == SIZE && backbuffer[3] == SIZE / 2);
+    return true;
+}
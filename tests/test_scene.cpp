@@ -0,0 +1,382 @@
+#include "harness.h"
+#include "../scene.h"
+#include "../scenestreamer.h"
+
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+#include <thread>
+
+
+static const char* SCENE_PATH = "tests/fixture.scene";
+static const char* TEXTURE_PATH = "tests/fixture_scene.ktx";
+
+static const float CELL_SIZE = 10.0f;
+
+// A flat `cells` x `cells` grid, one unit across, in the y = 0 plane
+static void buildTile(int cells, std::vector<vertexPosColor>& vertices, std::vector<GLuint>& indices) {
+    for (int z = 0; z <= cells; z++) {
+        for (int x = 0; x <= cells; x++) {
+            vertexPosColor v = { (float)x / cells - 0.5f, 0.0f, (float)z / cells - 0.5f,
+                                 (float)x / cells, (float)z / cells, 1.0f };
+            vertices.push_back(v);
+        }
+    }
+    for (int z = 0; z < cells; z++) {
+        for (int x = 0; x < cells; x++) {
+            GLuint i = z * (cells + 1) + x;
+            GLuint quad[6] = { i, i + cells + 1, i + 1, i + 1, i + cells + 1, i + cells + 2 };
+            indices.insert(indices.end(), quad, quad + 6);
+        }
+    }
+}
+
+static void translation(float x, float y, float z, float model[16]) {
+    memset(model, 0, 16 * sizeof(float));
+    model[0] = model[5] = model[10] = model[15] = 1.0f;
+    model[12] = x;
+    model[13] = y;
+    model[14] = z;
+}
+
+// A row of `cells` cells along x, each with two instances of its own tile mesh
+static bool writeRow(int cells, int tileSize) {
+    GL::SceneBuilder builder(CELL_SIZE);
+    GLint texture = builder.addTexture(TEXTURE_PATH);
+
+    for (int c = 0; c < cells; c++) {
+        std::vector<vertexPosColor> vertices;
+        std::vector<GLuint> indices;
+        buildTile(tileSize, vertices, indices);
+        // Only level 0: these tests are about streaming, and generating levels takes time
+        GLuint mesh = builder.addMesh(vertices, indices, 1);
+
+        float model[16];
+        translation(c * CELL_SIZE + 3.0f, 0.0f, 5.0f, model);
+        builder.addInstance(mesh, texture, model);
+        translation(c * CELL_SIZE + 7.0f, 0.0f, 5.0f, model);
+        builder.addInstance(mesh, -1, model);
+    }
+
+    return builder.write(SCENE_PATH);
+}
+
+static std::vector<unsigned char> readFile(const char* path) {
+    std::vector<unsigned char> data;
+    FILE* fp = fopen(path, "rb");
+    if (fp) {
+        unsigned char buffer[4096];
+        size_t read;
+        while ((read = fread(buffer, 1, sizeof(buffer), fp)) > 0) {
+            data.insert(data.end(), buffer, buffer + read);
+        }
+        fclose(fp);
+    }
+    return data;
+}
+
+
+TEST_CASE(scene_round_trip) {
+    GL::SceneBuilder builder(CELL_SIZE);
+
+    std::vector<vertexPosColor> vertices;
+    std::vector<GLuint> indices;
+    buildTile(4, vertices, indices);
+    GLuint tile = builder.addMesh(vertices, indices);
+    GLint texture = builder.addTexture("textures/grass.ktx");
+
+    // Added out of cell order; the file groups them
+    const float positions[4][3] = { { 25.0f, 0.0f, 3.0f }, { 2.0f, 1.0f, -4.0f }, { 27.0f, 0.0f, 8.0f }, { -3.0f, 0.0f, -1.0f } };
+    for (int i = 0; i < 4; i++) {
+        float model[16];
+        translation(positions[i][0], positions[i][1], positions[i][2], model);
+        builder.addInstance(tile, i % 2 == 0 ? texture : -1, model);
+    }
+    CHECK(builder.write(SCENE_PATH));
+
+    GL::Scene scene;
+    bool loaded = scene.load(SCENE_PATH);
+    remove(SCENE_PATH);
+    CHECK(loaded);
+
+    const GL::SceneHeader& h = scene.header();
+    CHECK(h.meshCount == 1 && h.textureCount == 1 && h.instanceCount == 4);
+    CHECK(h.cellSize == CELL_SIZE);
+
+    // Cells (-1,-1), (0,-1) and (2,0), sorted by z then x
+    CHECK(h.cellCount == 3);
+    CHECK(scene.findCell(-1, -1) == 0);
+    CHECK(scene.findCell(0, -1) == 1);
+    CHECK(scene.findCell(2, 0) == 2);
+    CHECK(scene.findCell(1, 0) == -1);
+
+    const GL::SceneCell& far = scene.cell(2);
+    CHECK(far.instanceCount == 2);
+    for (GLuint i = far.firstInstance; i < far.firstInstance + far.instanceCount; i++) {
+        const float* model = scene.instance(i).model;
+        CHECK(model[12] >= far.min[0] && model[12] <= far.max[0]);
+        CHECK(model[14] >= far.min[2] && model[14] <= far.max[2]);
+        CHECK(scene.instance(i).texture == texture);
+    }
+
+    // The data is used where it lies in the mapping
+    const GL::SceneMesh& mesh = scene.mesh(tile);
+    CHECK(mesh.vertexCount == vertices.size());
+    CHECK(((const unsigned char*)mesh.vertices.pointer - (const unsigned char*)&h) % GL::SCENE_PAGE_SIZE == 0);
+    CHECK(memcmp(mesh.vertices.pointer, &vertices[0], vertices.size() * sizeof(vertexPosColor)) == 0);
+    CHECK(mesh.radius > 0.7f && mesh.radius < 0.75f);
+
+    // Level 0 is the mesh as given; the coarser levels follow it in the same indices
+    std::vector<GLuint> lodIndices;
+    std::vector<GL::Lod::Level> levels;
+    GL::Lod::generate(vertices, indices, GL::SCENE_MAX_LEVELS, 0.5f, lodIndices, levels);
+    CHECK(mesh.levelCount == levels.size() && mesh.levelCount > 1);
+    CHECK(mesh.levels[0].firstIndex == 0 && mesh.levels[0].indexCount == (GLsizei)indices.size());
+    for (GLuint l = 0; l < mesh.levelCount; l++) {
+        CHECK(mesh.levels[l].firstIndex == levels[l].firstIndex && mesh.levels[l].indexCount == levels[l].indexCount);
+        CHECK(mesh.levels[l].error == levels[l].error);
+    }
+    CHECK(mesh.indexCount == lodIndices.size());
+    CHECK(memcmp(mesh.indices.pointer, &lodIndices[0], lodIndices.size() * sizeof(GLuint)) == 0);
+
+    CHECK(strcmp(scene.texture(texture).path.pointer, "textures/grass.ktx") == 0);
+    return true;
+}
+
+
+struct LoadCall
+{
+    GL::Scene*  scene;
+    const char* path;
+    bool        result;
+};
+
+static void loadScene(void* userData) {
+    LoadCall* call = (LoadCall*)userData;
+    call->result = call->scene->load(call->path);
+}
+
+// Writes `data` as a scene file and checks that loading it fails with `reason`
+static bool rejects(std::vector<unsigned char> data, const char* reason) {
+    CHECK(Test::writeFile(SCENE_PATH, &data[0], data.size()));
+
+    GL::Scene scene;
+    LoadCall call = { &scene, SCENE_PATH, true };
+    const char* printed = Test::captureStderr(loadScene, &call);
+    remove(SCENE_PATH);
+
+    CHECK(!call.result);
+    CHECK(strstr(printed, reason) != NULL);
+    return true;
+}
+
+TEST_CASE(scene_rejects_bad_files) {
+    CHECK(writeRow(2, 4));
+    std::vector<unsigned char> good = readFile(SCENE_PATH);
+    CHECK(good.size() > sizeof(GL::SceneHeader));
+    GL::SceneHeader h;
+    memcpy(&h, &good[0], sizeof(h));
+
+    std::vector<unsigned char> bad = good;
+    bad[0] = 'X';
+    CHECK(rejects(bad, "not a scene file"));
+
+    bad = good;
+    bad.resize(good.size() - 1);
+    CHECK(rejects(bad, "the file is truncated"));
+
+    // A mesh whose data runs off the end of the file
+    bad = good;
+    GL::SceneMesh* mesh = (GL::SceneMesh*)&bad[h.meshes.offset];
+    mesh->indices.offset = good.size() - sizeof(GLuint);
+    CHECK(rejects(bad, "mesh data lies outside the file"));
+
+    // A level of detail reaching past the mesh's indices
+    bad = good;
+    mesh = (GL::SceneMesh*)&bad[h.meshes.offset];
+    mesh->levels[mesh->levelCount - 1].indexCount += 3;
+    CHECK(rejects(bad, "a level of detail lies outside its mesh"));
+
+    bad = good;
+    GL::SceneInstance* instance = (GL::SceneInstance*)&bad[h.instances.offset];
+    instance->mesh = h.meshCount;
+    CHECK(rejects(bad, "an instance refers to a missing mesh or texture"));
+
+    bad = good;
+    GL::SceneCell* cells = (GL::SceneCell*)&bad[h.cells.offset];
+    std::swap(cells[0], cells[1]);
+    CHECK(rejects(bad, "cells are out of order"));
+    return true;
+}
+
+
+// Uploads until every requested cell is resident, checking that no call
+// goes over `budget` bytes. Returns the number of calls that uploaded something.
+static int uploadAll(GL::SceneStreamer& streamer, size_t budget, bool& withinBudget) {
+    int calls = 0;
+    withinBudget = true;
+
+    std::chrono::steady_clock::time_point timeout = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (streamer.isBusy() && std::chrono::steady_clock::now() < timeout) {
+        size_t spent = streamer.upload(budget);
+        if (spent > 0) {
+            calls++;
+            withinBudget = withinBudget && spent <= budget;
+        } else {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+    return calls;
+}
+
+// Reads a resident mesh's indices back from the streamer's shared index buffer
+static std::vector<GLuint> readIndices(const GL::SceneStreamer& streamer, GLuint mesh) {
+    const GL::SceneStreamer::GpuMesh& gpuMesh = streamer.gpuMesh(mesh);
+    GLint buffer = 0;
+    glBindVertexArray(streamer.vertexArray());
+    glGetIntegerv(GL_ELEMENT_ARRAY_BUFFER_BINDING, &buffer);
+    glBindVertexArray(0);
+
+    std::vector<GLuint> indices(gpuMesh.indexCount);
+    glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+    glGetBufferSubData(GL_COPY_READ_BUFFER, gpuMesh.firstIndex * sizeof(GLuint), indices.size() * sizeof(GLuint), &indices[0]);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    return indices;
+}
+
+TEST_CASE(scene_streams_cells_around_the_eye) {
+    CHECK(writeRow(10, 24));
+
+    GL::Scene scene;
+    CHECK(scene.load(SCENE_PATH));
+
+    const GL::SceneMesh& tile = scene.mesh(0);
+    size_t meshBytes = tile.vertexCount * sizeof(vertexPosColor) + tile.indexCount * sizeof(GLuint);
+
+    // Room for one mesh per call, so two cells take two calls
+    const size_t budget = meshBytes;
+
+    GL::SceneStreamer streamer;
+    streamer.start(scene, 12.0f, 20.0f);
+
+    // At the row's start, cells 0 and 1 are in reach
+    float eye[3] = { 5.0f, 0.0f, 5.0f };
+    streamer.update(eye);
+    CHECK(streamer.isBusy());
+
+    bool withinBudget = false;
+    CHECK(uploadAll(streamer, budget, withinBudget) == 2);
+    CHECK(withinBudget);
+    CHECK(!streamer.isBusy());
+    CHECK(streamer.residentCells().size() == 2);
+    CHECK(streamer.cellsLoaded() == 2);
+    CHECK(streamer.residentBytes() == 2 * meshBytes);
+
+    // Both instances of a cell share one upload of its mesh, straight from the
+    // file, and the two meshes sit side by side in the shared buffers
+    GLuint mesh0 = scene.instance(0).mesh;
+    GLuint mesh1 = scene.instance(scene.cell(1).firstInstance).mesh;
+    const GL::SceneStreamer::GpuMesh& first = streamer.gpuMesh(mesh0);
+    const GL::SceneStreamer::GpuMesh& second = streamer.gpuMesh(mesh1);
+    CHECK(streamer.vertexArray() != 0);
+    CHECK(first.users == 2 && second.users == 2);
+    CHECK(first.indexCount == (GLsizei)tile.indexCount);
+    CHECK(first.firstIndex + tile.indexCount <= second.firstIndex || second.firstIndex + tile.indexCount <= first.firstIndex);
+    CHECK(first.baseVertex + (GLint)tile.vertexCount <= second.baseVertex || second.baseVertex + (GLint)tile.vertexCount <= first.baseVertex);
+    for (GLuint m = 0; m < 2; m++) {
+        std::vector<GLuint> indices = readIndices(streamer, m == 0 ? mesh0 : mesh1);
+        CHECK(memcmp(&indices[0], tile.indices.pointer, indices.size() * sizeof(GLuint)) == 0);
+    }
+
+    // At the far end, the first cells are evicted and the last ones loaded
+    eye[0] = 95.0f;
+    streamer.update(eye);
+    CHECK(streamer.cellsEvicted() == 2);
+    CHECK(streamer.gpuMesh(mesh0).users == 0);
+    uploadAll(streamer, budget, withinBudget);
+    CHECK(withinBudget);
+    CHECK(streamer.residentCells().size() == 2);
+    CHECK(scene.findCell(8, 0) >= 0 && scene.findCell(9, 0) >= 0);
+
+    // The new meshes reuse the space the evicted ones left
+    for (int c = 8; c <= 9; c++) {
+        GLuint mesh = scene.instance(scene.cell(scene.findCell(c, 0)).firstInstance).mesh;
+        CHECK(streamer.gpuMesh(mesh).firstIndex + tile.indexCount <= 2 * tile.indexCount);
+        std::vector<GLuint> indices = readIndices(streamer, mesh);
+        CHECK(memcmp(&indices[0], tile.indices.pointer, indices.size() * sizeof(GLuint)) == 0);
+    }
+
+    // Passing through the middle without stopping loads nothing there
+    eye[0] = 45.0f;
+    streamer.update(eye);
+    eye[0] = 95.0f;
+    streamer.update(eye);
+    uploadAll(streamer, budget, withinBudget);
+    CHECK(streamer.residentCells().size() == 2);
+    for (int c = 3; c <= 5; c++) {
+        CHECK(streamer.gpuMesh(scene.instance(scene.cell(c).firstInstance).mesh).users == 0);
+    }
+    CHECK(streamer.residentBytes() == 2 * meshBytes);
+
+    // Everything out of reach: nothing stays in the GL
+    eye[0] = 1000.0f;
+    streamer.update(eye);
+    CHECK(streamer.residentCells().empty());
+    CHECK(streamer.residentBytes() == 0);
+
+    streamer.stop();
+    scene.unload();
+    remove(SCENE_PATH);
+    return true;
+}
+
+
+struct StreamCall
+{
+    GL::SceneStreamer*  streamer;
+    const float*        eye;
+    bool                withinBudget;
+};
+
+static void streamAll(void* userData) {
+    StreamCall* call = (StreamCall*)userData;
+    call->streamer->update(call->eye);
+    uploadAll(*call->streamer, 1 << 20, call->withinBudget);
+}
+
+TEST_CASE(scene_streamer_skips_broken_cells) {
+    CHECK(writeRow(3, 4));
+
+    // The middle cell's mesh has an index past its last vertex, in its
+    // coarsest level. Loading only checks the tables, so the file still loads.
+    std::vector<unsigned char> data = readFile(SCENE_PATH);
+    GL::SceneHeader h;
+    memcpy(&h, &data[0], sizeof(h));
+    GL::SceneMesh* mesh = (GL::SceneMesh*)&data[h.meshes.offset] + 1;
+    ((GLuint*)&data[mesh->indices.offset])[mesh->indexCount - 1] = mesh->vertexCount;
+    CHECK(Test::writeFile(SCENE_PATH, &data[0], data.size()));
+
+    GL::Scene scene;
+    CHECK(scene.load(SCENE_PATH));
+
+    GL::SceneStreamer streamer;
+    streamer.start(scene, 30.0f, 40.0f);
+
+    // Every cell is in reach, but only the good ones come in
+    float eye[3] = { 15.0f, 0.0f, 5.0f };
+    StreamCall call = { &streamer, eye, false };
+    const char* printed = Test::captureStderr(streamAll, &call);
+    CHECK(strstr(printed, "Skipping scene cell 1, 0") != NULL);
+    CHECK(!streamer.isBusy());
+    CHECK(streamer.residentCells().size() == 2);
+    CHECK(streamer.gpuMesh(1).users == 0);
+
+    // And the broken one isn't asked for again
+    streamer.update(eye);
+    CHECK(!streamer.isBusy());
+
+    streamer.stop();
+    scene.unload();
+    remove(SCENE_PATH);
+    return true;
+}
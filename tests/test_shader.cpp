@@ -0,0 +1,108 @@
+#include "harness.h"
+#include "../shader.h"
+
+#include <string.h>
+
+
+static const char VERTEX_PATH[] = "vertex.shader";
+static const char FRAGMENT_PATH[] = "fragment.shader";
+static const char BROKEN_PATH[] = "tests/data/broken.shader";
+static const char UNDEFINED_PATH[] = "tests/data/undefined.shader";
+static const char MISSING_PATH[] = "tests/data/missing.shader";
+
+static void compileBroken(void* shader) {
+    *(GL::Shader*)shader = GL::Shader(GL_FRAGMENT_SHADER, BROKEN_PATH);
+}
+
+static void compileMissing(void* shader) {
+    *(GL::Shader*)shader = GL::Shader(GL_FRAGMENT_SHADER, MISSING_PATH);
+}
+
+static GLint linkStatus(GLuint program) {
+    GLint status;
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+    return status;
+}
+
+
+TEST_CASE(shader_compiles) {
+    GL::Shader vertex(GL_VERTEX_SHADER, VERTEX_PATH);
+    GL::Shader fragment(GL_FRAGMENT_SHADER, FRAGMENT_PATH);
+
+    CHECK(vertex.status() == GL_TRUE);
+    CHECK(fragment.status() == GL_TRUE);
+
+    glDeleteShader(vertex.getHandle());
+    glDeleteShader(fragment.getHandle());
+    return true;
+}
+
+TEST_CASE(shader_compile_error_is_logged) {
+    GL::Shader shader;
+    const char* log = Test::captureStderr(compileBroken, &shader);
+
+    CHECK(shader.status() == GL_FALSE);
+    CHECK(strstr(log, "Shader Compile failure in tests/data/broken.shader") != NULL);
+
+    glDeleteShader(shader.getHandle());
+    return true;
+}
+
+TEST_CASE(shader_missing_source_is_logged) {
+    GL::Shader shader;
+    const char* log = Test::captureStderr(compileMissing, &shader);
+
+    CHECK(shader.status() == GL_FALSE);
+    CHECK(strstr(log, "tests/data/missing.shader") != NULL);
+
+    glDeleteShader(shader.getHandle());
+    return true;
+}
+
+TEST_CASE(shader_links_program) {
+    GLuint program;
+    GL::Shader vertex, fragment;
+    GL::Shader::createProgramLinkedWithShadersVF(program, vertex, VERTEX_PATH, fragment, FRAGMENT_PATH);
+
+    CHECK(linkStatus(program) == GL_TRUE);
+
+    glDeleteProgram(program);
+    return true;
+}
+
+TEST_CASE(shader_link_error) {
+    GLuint program;
+    GL::Shader vertex, fragment;
+    GL::Shader::createProgramLinkedWithShadersVF(program, vertex, VERTEX_PATH, fragment, UNDEFINED_PATH);
+
+    CHECK(linkStatus(program) == GL_FALSE);
+
+    glDeleteProgram(program);
+    return true;
+}
+
+TEST_CASE(shader_uniform_block_introspection) {
+    GLuint program;
+    GL::Shader vertex, fragment;
+    GL::Shader::createProgramLinkedWithShadersVF(program, vertex, VERTEX_PATH, fragment, FRAGMENT_PATH);
+
+    // Must agree with `perObject` in main.cpp
+    CHECK(GL::Shader::uniformBlockSize(program, "PerObject") == 80);
+    CHECK(GL::Shader::checkUniformBlockSize(program, "PerObject", 80));
+    CHECK(GL::Shader::uniformOffset(program, "model") == 0);
+    CHECK(GL::Shader::uniformOffset(program, "tint") == 64);
+
+    GLuint blockIndex = GL::Shader::bindUniformBlock(program, "PerObject", 3);
+    CHECK(blockIndex != GL_INVALID_INDEX);
+
+    GLint binding;
+    glGetActiveUniformBlockiv(program, blockIndex, GL_UNIFORM_BLOCK_BINDING, &binding);
+    CHECK(binding == 3);
+
+    // Lookups of things the program doesn't have fail softly
+    CHECK(GL::Shader::uniformBlockSize(program, "Missing") == -1);
+    CHECK(GL::Shader::uniformOffset(program, "missing") == -1);
+
+    glDeleteProgram(program);
+    return true;
+}
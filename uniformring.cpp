@@ -0,0 +1,141 @@
+#include "uniformring.h"
+#include "debugoutput.h"
+
+#include <stdio.h>
+#include <string.h>
+
+namespace GL {
+    // Public
+
+    UniformRing::UniformRing()
+        : _handle(0), _alignment(256), _frameSize(0), _framesInFlight(0),
+          _frame(0), _used(0), _flushed(0), _staging(NULL), _fences(NULL) {}
+
+    UniformRing::~UniformRing() {
+        delete[] _staging;
+        delete[] _fences;
+    }
+
+    /**
+     * Creates the backing buffer. Every region starts on an offset that
+     * glBindBufferRange accepts, so blocks can be bound from anywhere in it.
+     */
+    void UniformRing::create(GLsizeiptr frameSize, GLuint framesInFlight) {
+        destroy();
+
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &_alignment);
+
+        _frameSize = (frameSize + (_alignment - 1)) / _alignment * _alignment;
+        _framesInFlight = framesInFlight > 0 ? framesInFlight : 1;
+        _frame = 0;
+        _used = 0;
+        _flushed = 0;
+
+        _staging = new unsigned char[_frameSize];
+        _fences = new GLsync[_framesInFlight];
+        memset(_fences, 0, sizeof(GLsync) * _framesInFlight);
+
+        glGenBuffers(1, &_handle);
+        glBindBuffer(GL_UNIFORM_BUFFER, _handle);
+        glBufferData(GL_UNIFORM_BUFFER, _frameSize * _framesInFlight, NULL, GL_STREAM_DRAW);
+        DebugOutput::label(GL_BUFFER, _handle, "Uniform ring");
+
+        printf("Creating uniform ring: %i regions of %li bytes ID: %i\n",
+               _framesInFlight, (long)_frameSize, _handle);
+    }
+
+    void UniformRing::destroy() {
+        if (_fences) {
+            for (GLuint i = 0; i < _framesInFlight; i++) {
+                if (_fences[i]) {
+                    glDeleteSync(_fences[i]);
+                }
+            }
+        }
+        if (_handle) {
+            glDeleteBuffers(1, &_handle);
+            _handle = 0;
+        }
+
+        delete[] _staging;
+        delete[] _fences;
+        _staging = NULL;
+        _fences = NULL;
+    }
+
+    GLuint UniformRing::getHandle() {
+        return _handle;
+    }
+
+    void UniformRing::beginFrame() {
+        _frame = (_frame + 1) % _framesInFlight;
+        _used = 0;
+        _flushed = 0;
+
+        GLsync fence = _fences[_frame];
+        if (fence) {
+            // Only blocks when the CPU is more than `framesInFlight` frames ahead
+            GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+            while (result == GL_TIMEOUT_EXPIRED) {
+                result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+            }
+            glDeleteSync(fence);
+            _fences[_frame] = 0;
+        }
+    }
+
+    void UniformRing::endFrame() {
+        _fences[_frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    GLintptr UniformRing::push(const void* data, GLsizeiptr size) {
+        GLsizeiptr offset = _used;
+        GLsizeiptr next = offset + (size + (_alignment - 1)) / _alignment * _alignment;
+
+        if (next > _frameSize) {
+            fprintf(stderr, "Uniform ring %i is full: %li of %li bytes used, %li more pushed\n",
+                    _handle, (long)_used, (long)_frameSize, (long)size);
+            return -1;
+        }
+
+        memcpy(_staging + offset, data, size);
+        _used = next;
+
+        return _frame * _frameSize + offset;
+    }
+
+    /**
+     * Uploads whatever was pushed since the last flush. The fences make sure
+     * the region is idle, so the map doesn't need to synchronize.
+     */
+    void UniformRing::flush() {
+        GLsizeiptr size = _used - _flushed;
+
+        if (size <= 0) {
+            return;
+        }
+
+        glBindBuffer(GL_UNIFORM_BUFFER, _handle);
+        void* dst = glMapBufferRange(
+            GL_UNIFORM_BUFFER,
+            _frame * _frameSize + _flushed,
+            size,
+            GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT
+        );
+
+        if (dst) {
+            memcpy(dst, _staging + _flushed, size);
+            glUnmapBuffer(GL_UNIFORM_BUFFER);
+        } else {
+            glBufferSubData(GL_UNIFORM_BUFFER, _frame * _frameSize + _flushed, size, _staging + _flushed);
+        }
+
+        _flushed = _used;
+    }
+
+    void UniformRing::bindRange(GLuint bindingPoint, GLintptr offset, GLsizeiptr size) {
+        glBindBufferRange(GL_UNIFORM_BUFFER, bindingPoint, _handle, offset, size);
+    }
+
+    // END Public
+}
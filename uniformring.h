@@ -0,0 +1,68 @@
+#ifndef UNIFORMRING_H
+#define UNIFORMRING_H
+
+#include <GL/glew.h>
+
+namespace GL {
+
+    /**
+     * A single large uniform buffer that per-object constants are streamed
+     * into once per frame.
+     *
+     * Objects push() their block data linearly into a CPU-side staging area,
+     * flush() copies the whole frame to the GL in one upload, and each draw
+     * then selects its slice with bindRange(). The buffer is split into
+     * `framesInFlight` regions guarded by fences, so the CPU never writes into
+     * a region that the GPU may still be reading from.
+     */
+    class UniformRing {
+    public:
+        UniformRing();
+        ~UniformRing();
+
+        // Allocates the GL buffer, with `frameSize` bytes available per frame
+        void create(GLsizeiptr frameSize, GLuint framesInFlight = 3);
+        void destroy(); // Releases the GL buffer and fences.
+
+        GLuint getHandle(); // Returns the ID referring to the buffer in the GL.
+
+        void beginFrame(); // Moves to the next region, waiting for the GPU if it is still in use.
+        void endFrame(); // Fences the current region once the frame's draws are submitted.
+
+        // Copies a block into the frame's staging area. Returns the block's
+        // offset within the GL buffer, or logs and returns -1 if the frame is
+        // out of space; the caller must then skip the draw using it.
+        GLintptr push(const void* data, GLsizeiptr size);
+
+        template<typename T>
+        GLintptr push(const T& block) {
+            return push(&block, sizeof(T));
+        }
+
+        void flush(); // Uploads everything pushed this frame in one go.
+
+        // Binds a pushed block to a GL_UNIFORM_BUFFER binding point
+        void bindRange(GLuint bindingPoint, GLintptr offset, GLsizeiptr size);
+
+        template<typename T>
+        void bindRange(GLuint bindingPoint, GLintptr offset) {
+            bindRange(bindingPoint, offset, sizeof(T));
+        }
+
+    private:
+        GLuint _handle;
+        GLint _alignment;           // GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+        GLsizeiptr _frameSize;      // Bytes per region, rounded up to _alignment
+        GLuint _framesInFlight;
+        GLuint _frame;              // Index of the region being written
+        GLsizeiptr _used;           // Bytes pushed into the current region
+        GLsizeiptr _flushed;        // Bytes of the current region already uploaded
+        unsigned char* _staging;
+        GLsync* _fences;
+
+        UniformRing(const UniformRing&);
+        UniformRing& operator=(const UniformRing&);
+    };
+}
+
+#endif
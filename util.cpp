@@ -1,4 +1,5 @@
 #include "Util.h"
+#include "debugoutput.h"
 
 #include <cstdio>
 #include <cstdlib>
@@ -11,7 +12,7 @@ namespace Util {
 namespace Files {
 
     extern
-    char* fileToBuffer(char* file) {
+    char* fileToBuffer(const char* file) {
 
         FILE *fptr;
         long length;
@@ -57,7 +58,7 @@ namespace KTX {
         return b.u32;
     }
 
-    static const unsigned short swap16(const unsigned short u16)
+    static inline unsigned short swap16(const unsigned short u16)
     {
         union
         {
@@ -108,7 +109,6 @@ namespace KTX {
     unsigned int loadKtx(const char * filePath, unsigned int texture)
     {
         FILE * fp;
-        GLuint temp = 0;
         GLuint retval = 0;
         header h;
         size_t data_start, data_end;
@@ -202,13 +202,13 @@ namespace KTX {
             goto fail_header;
         }
 
-        temp = texture;
         if (texture == 0)
         {
             glGenTextures(1, &texture);
         }
 
         glBindTexture(target, texture);
+        GL::DebugOutput::label(GL_TEXTURE, texture, filePath);
 
         data_start = ftell(fp) + h.keypairbytes;
         fseek(fp, 0, SEEK_END);
@@ -229,7 +229,7 @@ namespace KTX {
         {
             case GL_TEXTURE_1D:
                 glTexStorage1D(GL_TEXTURE_1D, h.miplevels, h.glinternalformat, h.pixelwidth);
-                glTexSubImage1D(GL_TEXTURE_1D, 0, 0, h.pixelwidth, h.glformat, h.glinternalformat, data);
+                glTexSubImage1D(GL_TEXTURE_1D, 0, 0, h.pixelwidth, h.glformat, h.gltype, data);
                 break;
             case GL_TEXTURE_2D:
                 glTexStorage2D(GL_TEXTURE_2D, h.miplevels, h.glinternalformat, h.pixelwidth, h.pixelheight);
@@ -275,7 +275,7 @@ namespace KTX {
                 }
                 break;
             case GL_TEXTURE_CUBE_MAP_ARRAY:
-                glTexStorage3D(GL_TEXTURE_CUBE_MAP_ARRAY, h.miplevels, h.glinternalformat, h.pixelwidth, h.pixelheight, h.arrayelements);
+                glTexStorage3D(GL_TEXTURE_CUBE_MAP_ARRAY, h.miplevels, h.glinternalformat, h.pixelwidth, h.pixelheight, h.faces * h.arrayelements);
                 glTexSubImage3D(GL_TEXTURE_CUBE_MAP_ARRAY, 0, 0, 0, 0, h.pixelwidth, h.pixelheight, h.faces * h.arrayelements, h.glformat, h.gltype, data);
                 break;
             default:                                               // Should never happen
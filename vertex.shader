@@ -6,6 +6,14 @@
 layout ( location = 0 ) in vec3 position;
 layout ( location = 1 ) in vec3 color;
 
+// Per-object constants, streamed each frame through GL::UniformRing.
+// Must stay in sync with `perObject` in main.cpp.
+layout ( std140 ) uniform PerObject
+{
+    mat4 model;
+    vec4 tint;
+};
+
 
 out vec3 Color;
 
@@ -13,8 +21,8 @@ out vec3 Color;
 
 void main()
 {
-    Color = color;
-    gl_Position = vec4(position, 1.0f);
+    Color = color * tint.rgb;
+    gl_Position = model * vec4(position, 1.0f);
 
 }
     